@@ -0,0 +1,48 @@
+// Scans the same synthetic code with every idiom of the benchmark, generated with one backend and linked into one scanner.
+// Usage: scan_bench [number of instructions] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "opcode/ppc.h"
+
+#include "aipg/aipg.hpp"
+#include "Bench.hpp"
+
+// the udiv sequence of the tests, which the Udiv copies match
+constexpr uint32_t UDIV_INS[] = {0x3c608889, 0x811c0014, 0x38038889, 0x38800000, 0x7c003896, 0x38600001, 0x7c003a14, 0x7c002e70, 0x54050ffe, 0x7cc02a14};
+
+// li r4, 0; lwz r5, 8(r1); stw r3, 8(r1); add r3, r4, r5; rlwinm r3, r3, 0, 0, 31; blr
+constexpr uint32_t FILLER_INS[] = {0x38800000, 0x80a10008, 0x90610008, 0x7c642a14, 0x5463003e, 0x4e800020};
+
+int main(int argc, char** argv) {
+  size_t numIns = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1 << 14;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::vector<uint32_t> ins;
+  while (ins.size() < numIns) {
+    ins.insert(ins.end(), std::begin(UDIV_INS), std::end(UDIV_INS));
+    for (int i = 0; i < 4; i++)
+      ins.insert(ins.end(), std::begin(FILLER_INS), std::end(FILLER_INS));
+  }
+  ins.resize(numIns);
+
+  double bestSeconds = 0;
+  size_t numMatches = 0;
+  for (int repetition = 0; repetition < repetitions; repetition++) {
+    numMatches = 0;
+    auto start = std::chrono::steady_clock::now();
+    aipg::scanBench(ins.begin(), ins.end(), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+      [&](aipg::BenchIdiom, uint32_t, const aipg::Context&) { numMatches++; });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bestSeconds = repetition == 0 ? seconds : std::min(bestSeconds, seconds);
+  }
+
+  std::cout << numIns << " instructions, " << numMatches << " matches, best of " << repetitions << ": "
+            << bestSeconds * 1e3 << " ms, " << numIns / bestSeconds / 1e6 << " M instructions/s" << std::endl;
+  return 0;
+}
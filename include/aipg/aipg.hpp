@@ -1,11 +1,23 @@
 
 #pragma once
 
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 namespace aipg {
+/// @brief Mixes value into seed, to hash the captures of partial matches
+constexpr uint64_t hashCombine(uint64_t seed, uint64_t value) {
+  uint64_t hash = (seed ^ value) * 0x9e3779b97f4a7c15ull;
+  return hash ^ (hash >> 32);
+}
+
 struct Context {
   std::unordered_map<uint32_t, uint32_t> gprs;
   std::unordered_map<uint32_t, uint32_t> fprs;
@@ -14,5 +26,144 @@ struct Context {
 
   /// @brief The index of each instruction that matched with the idiom's assembly lines from the starting instruction
   std::vector<uint32_t> matchInsIdxs;
+
+  /// @brief Whether both contexts captured the same variables with the same values
+  bool hasSameBindings(const Context& other) const {
+    return gprs == other.gprs && fprs == other.fprs && imms == other.imms && labs == other.labs;
+  }
+
+  /// @brief Forget all captures, keeping the allocated storage for the next match attempt
+  void clear() {
+    gprs.clear();
+    fprs.clear();
+    imms.clear();
+    labs.clear();
+    matchInsIdxs.clear();
+  }
+};
+
+/// @brief Which variables of a FlatContext are bound, taken before binding new ones so that they can be rolled back
+struct BoundMasks {
+  uint64_t gprs;
+  uint64_t fprs;
+  uint64_t imms;
+  uint64_t labs;
+};
+
+/// @brief Size of a FlatContext and offsets of its members, so that code shared by all idioms (the table interpreter) can access their contexts
+struct ContextLayout {
+  uint32_t size;
+  uint32_t gprs;
+  uint32_t fprs;
+  uint32_t imms;
+  uint32_t labs;
+  uint32_t gprsBound;
+  uint32_t fprsBound;
+  uint32_t immsBound;
+  uint32_t labsBound;
+  uint32_t matchInsIdxs;
+};
+
+/// @brief Captures of a specific idiom, with a slot for each variable index up to the highest one the idiom uses
+/// and a bitmask of the bound slots, so that binding or reading a variable never hashes nor allocates.
+/// Labels are views of the names returned by the symbol getter, see aipg::hasStableSymbolNames
+template< uint32_t NumGprs, uint32_t NumFprs, uint32_t NumImms, uint32_t NumLabs, uint32_t NumLines >
+struct FlatContext {
+  static_assert(NumGprs <= 64 && NumFprs <= 64 && NumImms <= 64 && NumLabs <= 64, "variable indexes must be less than 64");
+
+  std::array<uint32_t, NumGprs> gprs{};
+  std::array<uint32_t, NumFprs> fprs{};
+  std::array<int32_t, NumImms> imms{};
+  std::array<std::string_view, NumLabs> labs{};
+
+  /// @brief Bit n is set when variable n is bound
+  uint64_t gprsBound = 0;
+  uint64_t fprsBound = 0;
+  uint64_t immsBound = 0;
+  uint64_t labsBound = 0;
+
+  /// @brief The index of each instruction that matched with the idiom's assembly lines from the starting instruction
+  std::array<uint32_t, NumLines> matchInsIdxs{};
+
+  bool hasSameBindings(const FlatContext& other) const {
+    if (gprsBound != other.gprsBound || fprsBound != other.fprsBound || immsBound != other.immsBound || labsBound != other.labsBound)
+      return false;
+    return sameBoundSlots(gprs, other.gprs, gprsBound) && sameBoundSlots(fprs, other.fprs, fprsBound) &&
+           sameBoundSlots(imms, other.imms, immsBound) && sameBoundSlots(labs, other.labs, labsBound);
+  }
+
+  /// @brief Hash of the bound variables and their values, equal for contexts with the same bindings
+  uint64_t bindingsHash() const {
+    uint64_t hash = hashCombine(hashCombine(hashCombine(hashCombine(0, gprsBound), fprsBound), immsBound), labsBound);
+    hash = hashBoundSlots(hash, gprs, gprsBound);
+    hash = hashBoundSlots(hash, fprs, fprsBound);
+    hash = hashBoundSlots(hash, imms, immsBound);
+    return hashBoundSlots(hash, labs, labsBound);
+  }
+
+  using BoundMasks = aipg::BoundMasks;
+
+  BoundMasks boundMasks() const { return {gprsBound, fprsBound, immsBound, labsBound}; }
+
+  /// @brief Unbinds the variables bound since bound was taken. Their slots keep stale values, which are never read while unbound
+  void restoreBoundMasks(const BoundMasks& bound) {
+    gprsBound = bound.gprs;
+    fprsBound = bound.fprs;
+    immsBound = bound.imms;
+    labsBound = bound.labs;
+  }
+
+  /// @brief Forget all captures
+  void clear() {
+    gprsBound = 0;
+    fprsBound = 0;
+    immsBound = 0;
+    labsBound = 0;
+  }
+
+  static constexpr ContextLayout layout() {
+    return {sizeof(FlatContext), offsetof(FlatContext, gprs), offsetof(FlatContext, fprs), offsetof(FlatContext, imms), offsetof(FlatContext, labs),
+            offsetof(FlatContext, gprsBound), offsetof(FlatContext, fprsBound), offsetof(FlatContext, immsBound), offsetof(FlatContext, labsBound),
+            offsetof(FlatContext, matchInsIdxs)};
+  }
+
+  /// @brief Copies the bound variables and the matched instructions to a generic Context
+  void toContext(Context& parseCtx) const {
+    parseCtx.clear();
+    copyBoundSlots(gprs, gprsBound, parseCtx.gprs);
+    copyBoundSlots(fprs, fprsBound, parseCtx.fprs);
+    copyBoundSlots(imms, immsBound, parseCtx.imms);
+    copyBoundSlots(labs, labsBound, parseCtx.labs);
+    parseCtx.matchInsIdxs.assign(matchInsIdxs.begin(), matchInsIdxs.end());
+  }
+
+private:
+  template< class T, size_t N >
+  static bool sameBoundSlots(const std::array<T, N>& slots, const std::array<T, N>& otherSlots, uint64_t bound) {
+    for (uint32_t i = 0; i < N; i++) {
+      if ((bound >> i) & 1 && slots[i] != otherSlots[i]) return false;
+    }
+    return true;
+  }
+
+  template< class T, size_t N >
+  static uint64_t hashBoundSlots(uint64_t hash, const std::array<T, N>& slots, uint64_t bound) {
+    for (; bound != 0; bound &= bound - 1) {
+      const T& slot = slots[std::countr_zero(bound)];
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        hash = hashCombine(hash, std::hash<std::string_view>()(slot));
+      } else {
+        hash = hashCombine(hash, static_cast<uint32_t>(slot));
+      }
+    }
+    return hash;
+  }
+
+  template< class T, size_t N, class Map >
+  static void copyBoundSlots(const std::array<T, N>& slots, uint64_t bound, Map& map) {
+    for (uint32_t i = 0; i < N; i++) {
+      if ((bound >> i) & 1) map[i] = slots[i];
+    }
+  }
 };
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+
+namespace aipg {
+/// @brief Converts between a big-endian word and the host's byte order
+constexpr uint32_t fromBigEndian(uint32_t word) {
+  if constexpr (std::endian::native == std::endian::little) return __builtin_bswap32(word);
+  else return word;
+}
+
+/// @brief Loads the big-endian word at bytes, which does not need to be aligned
+inline uint32_t loadBigEndian(const std::byte* bytes) {
+  uint32_t word;
+  std::memcpy(&word, bytes, sizeof(word));
+  return fromBigEndian(word);
+}
+
+/// @brief Random access iterator over the big-endian words of a byte image, loading each word as it is read.
+/// Lets the generated parsers scan raw (e.g. mmapped) images without copying them
+class BigEndianWordIterator {
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using iterator_concept = std::random_access_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = uint32_t;
+  using reference = uint32_t;
+  using pointer = void;
+
+  BigEndianWordIterator() = default;
+  explicit BigEndianWordIterator(const std::byte* bytes) : bytes(bytes) {}
+
+  /// @brief First byte of the current word
+  const std::byte* base() const { return bytes; }
+
+  uint32_t operator*() const { return loadBigEndian(bytes); }
+  uint32_t operator[](difference_type n) const { return loadBigEndian(bytes + 4*n); }
+
+  BigEndianWordIterator& operator++() { bytes += 4; return *this; }
+  BigEndianWordIterator operator++(int) { BigEndianWordIterator prev = *this; bytes += 4; return prev; }
+  BigEndianWordIterator& operator--() { bytes -= 4; return *this; }
+  BigEndianWordIterator operator--(int) { BigEndianWordIterator prev = *this; bytes -= 4; return prev; }
+  BigEndianWordIterator& operator+=(difference_type n) { bytes += 4*n; return *this; }
+  BigEndianWordIterator& operator-=(difference_type n) { bytes -= 4*n; return *this; }
+  friend BigEndianWordIterator operator+(BigEndianWordIterator it, difference_type n) { return it += n; }
+  friend BigEndianWordIterator operator+(difference_type n, BigEndianWordIterator it) { return it += n; }
+  friend BigEndianWordIterator operator-(BigEndianWordIterator it, difference_type n) { return it -= n; }
+  friend difference_type operator-(const BigEndianWordIterator& a, const BigEndianWordIterator& b) { return (a.bytes - b.bytes) / 4; }
+
+  friend bool operator==(const BigEndianWordIterator& a, const BigEndianWordIterator& b) { return a.bytes == b.bytes; }
+  friend auto operator<=>(const BigEndianWordIterator& a, const BigEndianWordIterator& b) { return a.bytes <=> b.bytes; }
+
+private:
+  const std::byte* bytes = nullptr;
+};
+static_assert(std::random_access_iterator<BigEndianWordIterator>);
+
+/// @brief The big-endian words of a byte image, a trailing partial word is ignored
+class BigEndianWords {
+public:
+  BigEndianWords(std::span<const std::byte> image) : image(image) {}
+  BigEndianWords(const uint8_t* data, size_t size) : image(reinterpret_cast<const std::byte*>(data), size) {}
+
+  BigEndianWordIterator begin() const { return BigEndianWordIterator(image.data()); }
+  BigEndianWordIterator end() const { return BigEndianWordIterator(image.data() + size()*4); }
+  size_t size() const { return image.size() / 4; }
+
+private:
+  std::span<const std::byte> image;
+};
+}
\ No newline at end of file
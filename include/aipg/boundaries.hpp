@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ppcdisasm/ppc-dis.hpp"
+#include "ppcdisasm/ppc-relocations.h"
+
+#include "aipg/symbols.hpp"
+
+namespace aipg {
+/// @brief Whether insn unconditionally leaves the current function without coming back to the next instruction: b, blr, bctr and rfi
+constexpr bool isFunctionExit(uint32_t insn) {
+  uint32_t primaryOpcode = insn >> 26;
+  if (primaryOpcode == 18) return (insn & 1) == 0; // b/ba, not bl
+  if (primaryOpcode != 19) return false;
+  uint32_t extendedOpcode = (insn >> 1) & 0x3ff;
+  if (extendedOpcode == 50) return true; // rfi
+  bool isBranchAlways = ((insn >> 21) & 0x14) == 0x14;
+  return (extendedOpcode == 16 || extendedOpcode == 528) && isBranchAlways && (insn & 1) == 0; // blr, bctr
+}
+
+/// @brief Whether symbolGetter reports that a symbol starts at vma, which it does by returning a named target without relocation
+template< class Getter >
+bool isSymbolStart(const Getter& symbolGetter, uint32_t vma) {
+  const auto& target = symbolGetter(vma);
+  return symbolKind(target) == R_PPC_NONE && !symbolName(target).empty();
+}
+
+/// @brief Whether a ... that stays within a function must stop before consuming insn at vma
+template< class Getter >
+bool isFunctionBoundary(uint32_t insn, uint32_t vma, const Getter& symbolGetter) {
+  return isFunctionExit(insn) || isSymbolStart(symbolGetter, vma);
+}
+}
\ No newline at end of file
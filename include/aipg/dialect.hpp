@@ -0,0 +1,19 @@
+#pragma once
+
+#include <type_traits>
+
+#include "opcode/ppc.h"
+
+namespace aipg {
+/// @brief A dialect known at compile time. Generated code takes it wherever it takes a ppc_cpu_t dialect, which lets the dialect checks
+/// constant-fold, e.g. matchUdiv<PPC_OPCODE_PPC | PPC_OPCODE_750>(first, last, parseCtx) passes FixedDialect<PPC_OPCODE_PPC | PPC_OPCODE_750>
+template< ppc_cpu_t Dialect >
+using FixedDialect = std::integral_constant<ppc_cpu_t, Dialect>;
+
+/// @brief Whether an opcode with the given flags and deprecated dialects is available in dialect, the same test as lookup_powerpc
+template< class DialectT >
+constexpr bool isOpcodeInDialect(ppc_cpu_t flags, ppc_cpu_t deprecated, DialectT dialect) {
+  return !(((dialect & PPC_OPCODE_ANY) == 0 && ((flags & dialect) == 0 || (deprecated & dialect) != 0))
+           || (deprecated & dialect & PPC_OPCODE_RAW) != 0);
+}
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace aipg {
+/// @brief Lazily evaluated input range of the values yielded by a coroutine, a minimal std::generator.
+/// Values are not copied: the iterator refers to the value passed to co_yield, which only lives until the coroutine resumes
+template< class T >
+class Generator {
+public:
+  struct promise_type {
+    const T* value = nullptr;
+    std::exception_ptr exception;
+
+    Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(const T& yielded) noexcept {
+      value = std::addressof(yielded);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { exception = std::current_exception(); }
+    // no co_await in generators
+    template< class U >
+    std::suspend_never await_transform(U&&) = delete;
+  };
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using reference = const T&;
+    using pointer = const T*;
+
+    iterator() = default;
+    explicit iterator(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+    reference operator*() const { return *coroutine.promise().value; }
+    pointer operator->() const { return coroutine.promise().value; }
+    iterator& operator++() {
+      coroutine.resume();
+      rethrowIfFailed();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const { return !coroutine || coroutine.done(); }
+
+  private:
+    std::coroutine_handle<promise_type> coroutine;
+
+    void rethrowIfFailed() {
+      if (coroutine.done() && coroutine.promise().exception)
+        std::rethrow_exception(std::exchange(coroutine.promise().exception, nullptr));
+    }
+
+    friend class Generator;
+  };
+
+  Generator(Generator&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+  Generator& operator=(Generator&& other) noexcept {
+    if (this != &other) {
+      if (coroutine) coroutine.destroy();
+      coroutine = std::exchange(other.coroutine, nullptr);
+    }
+    return *this;
+  }
+  ~Generator() {
+    if (coroutine) coroutine.destroy();
+  }
+
+  /// @brief Runs the coroutine up to its first co_yield, may only be called once
+  iterator begin() {
+    iterator it(coroutine);
+    ++it;
+    return it;
+  }
+  std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+  std::coroutine_handle<promise_type> coroutine;
+
+  explicit Generator(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+};
+}
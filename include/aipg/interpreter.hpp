@@ -0,0 +1,292 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#include "opcode/ppc.h"
+#include "ppcdisasm/ppc-dis.hpp"
+
+#include "aipg/aipg.hpp"
+#include "aipg/dialect.hpp"
+#include "aipg/nfa.hpp"
+#include "aipg/registers.hpp"
+#include "aipg/symbols.hpp"
+
+namespace aipg {
+/// @brief What the table interpreter checks for an operand of a line. Operands fixed by the line's mask are not in the table
+enum class OperandAction : uint8_t {
+  BindGpr,       // binds $GPRvar, or compares the operand with it once bound
+  BindFpr,       // same for $FPRvar
+  BindImm,       // same for $IMMvar
+  BindLab,       // same for $LABvar, with the symbol targeted at the instruction
+  CompareValue,  // defined operand whose value could not be folded into the line's mask
+  CompareLabel,  // defined label
+  OptionalValue, // skipped optional operand, which must hold its default value
+};
+
+/// @brief Operand of a line, along with how to extract its value from the instruction
+struct OperandEntry {
+  OperandAction action;
+  // variable index of the Bind actions
+  uint8_t var;
+  // the operand's custom extract function is called through operand_value_powerpc, otherwise its field is extracted inline
+  bool usesExtractFn;
+  int8_t shift;
+  uint32_t bitm;
+  // highest bit of the field if it is signed, 0 otherwise
+  uint32_t signBit;
+  uint32_t operandIdx;
+  // relocation kind the label must have, -1 for any
+  int relocKind;
+  // value of CompareValue, number of optional operands of OptionalValue
+  int64_t value;
+  // label of CompareLabel
+  const char* label;
+};
+
+/// @brief Kinds of register accesses ... constraints restrict, in the order of the fields of RegisterConstraints
+enum RegisterUseKind : uint8_t {
+  REGISTER_USE_GPR_READS,
+  REGISTER_USE_GPR_WRITES,
+  REGISTER_USE_FPR_READS,
+  REGISTER_USE_FPR_WRITES,
+};
+
+/// @brief Register listed in the constraints of a ..., e.g. the $GPR1 of ^$GPR1
+struct RegisterEntry {
+  RegisterUseKind use;
+  bool isFpr;
+  // val is a variable index rather than a register number
+  bool isVariable;
+  // listed after ^
+  bool isNotAllowed;
+  uint8_t val;
+};
+
+/// @brief Line of an idiom, with the ... before it if any
+struct LineEntry {
+  // bits of the instruction fixed by the mnemonic and the defined operands
+  uint32_t mask;
+  uint32_t value;
+  ppc_cpu_t opcodeFlags;
+  ppc_cpu_t opcodeDeprecated;
+  uint32_t firstOperand;
+  uint32_t numOperands;
+  bool isGap;
+  bool gapStopsAtFunctionEnd;
+  uint32_t gapMin;
+  uint32_t gapMax;
+  uint32_t firstRegister;
+  uint32_t numRegisters;
+  // bit n is set if the constraints of RegisterUseKind n list allowed registers, all the others are then denied
+  uint8_t hasAllowed;
+};
+
+/// @brief An idiom compiled to data, as generated by aipg --backend table. The entries of line l are
+/// operands[lines[l].firstOperand] to operands[lines[l].firstOperand + lines[l].numOperands], and likewise for registers
+struct IdiomTable {
+  const LineEntry* lines;
+  uint32_t numLines;
+  const OperandEntry* operands;
+  const RegisterEntry* registers;
+  // register use table of the instructions ... constraints apply to, see lookupRegisterUse
+  const OpcodeRegisterFields* registerFields;
+  const uint16_t* registerFieldsBuckets;
+  // where the members of the idiom's context are
+  ContextLayout layout;
+};
+
+/// @brief The lines of an idiom described by a table, run by aipg::PikeNfa. It is not templated on the idiom, the contexts are
+/// accessed through the table's ContextLayout, so that the interpreter's code is shared by all idioms and linking many idioms does not grow it
+class TableProgram {
+public:
+  explicit TableProgram(const IdiomTable& table) : table(&table) {}
+
+  uint32_t numLines() const { return table->numLines; }
+  const LineEntry& line(uint32_t lineIdx) const { return table->lines[lineIdx]; }
+  size_t contextSize() const { return table->layout.size; }
+
+  BoundMasks boundMasks(const std::byte* ctx) const {
+    const ContextLayout& layout = table->layout;
+    return {load<uint64_t>(ctx + layout.gprsBound), load<uint64_t>(ctx + layout.fprsBound), load<uint64_t>(ctx + layout.immsBound),
+            load<uint64_t>(ctx + layout.labsBound)};
+  }
+
+  /// @brief Unbinds the variables bound since bound was taken
+  void restoreBoundMasks(std::byte* ctx, const BoundMasks& bound) const {
+    const ContextLayout& layout = table->layout;
+    store(ctx + layout.gprsBound, bound.gprs);
+    store(ctx + layout.fprsBound, bound.fprs);
+    store(ctx + layout.immsBound, bound.imms);
+    store(ctx + layout.labsBound, bound.labs);
+  }
+
+  /// @brief Whether both contexts captured the same variables with the same values
+  bool hasSameBindings(const std::byte* ctx, const std::byte* other) const {
+    const ContextLayout& layout = table->layout;
+    return sameBoundSlots<uint32_t>(ctx, other, layout.gprs, layout.gprsBound) && sameBoundSlots<uint32_t>(ctx, other, layout.fprs, layout.fprsBound) &&
+           sameBoundSlots<int32_t>(ctx, other, layout.imms, layout.immsBound) && sameBoundSlots<std::string_view>(ctx, other, layout.labs, layout.labsBound);
+  }
+
+  /// @brief Hash of the bound variables and their values, equal for contexts with the same bindings
+  uint64_t hashBindings(const std::byte* ctx) const {
+    const ContextLayout& layout = table->layout;
+    uint64_t hash = 0;
+    for (uint32_t boundOffset : {layout.gprsBound, layout.fprsBound, layout.immsBound, layout.labsBound})
+      hash = hashCombine(hash, load<uint64_t>(ctx + boundOffset));
+    hash = hashBoundSlots<uint32_t>(hash, ctx, layout.gprs, layout.gprsBound);
+    hash = hashBoundSlots<uint32_t>(hash, ctx, layout.fprs, layout.fprsBound);
+    hash = hashBoundSlots<int32_t>(hash, ctx, layout.imms, layout.immsBound);
+    return hashBoundSlots<std::string_view>(hash, ctx, layout.labs, layout.labsBound);
+  }
+
+  void setMatchInsIdx(std::byte* ctx, uint32_t lineIdx, uint32_t insIdx) const {
+    store(ctx + table->layout.matchInsIdxs + lineIdx * sizeof(uint32_t), insIdx);
+  }
+
+  /// @brief Compiles the constraints of the ... before line, if any, with the variables bound before reaching it
+  RegisterConstraints gapConstraints(uint32_t lineIdx, const std::byte* ctx) const {
+    if (lineIdx == table->numLines || !table->lines[lineIdx].isGap) return {};
+    const LineEntry& line = table->lines[lineIdx];
+    const ContextLayout& layout = table->layout;
+    uint32_t forbidden[4] = {};
+    uint32_t allowed[4] = {};
+    for (uint32_t idx = line.firstRegister; idx < line.firstRegister + line.numRegisters; idx++) {
+      const RegisterEntry& reg = table->registers[idx];
+      uint32_t registers;
+      if (reg.isVariable) {
+        uint64_t bound = load<uint64_t>(ctx + (reg.isFpr ? layout.fprsBound : layout.gprsBound));
+        if ((bound & (1ull << reg.val)) == 0) continue;
+        registers = 1u << load<uint32_t>(ctx + (reg.isFpr ? layout.fprs : layout.gprs) + reg.val * sizeof(uint32_t));
+      } else {
+        registers = 1u << reg.val;
+      }
+      (reg.isNotAllowed ? forbidden : allowed)[reg.use] |= registers;
+    }
+    uint32_t denied[4];
+    for (uint32_t use = 0; use < 4; use++)
+      denied[use] = forbidden[use] | ((line.hasAllowed >> use) & 1 ? ~allowed[use] : 0);
+    return {denied[REGISTER_USE_GPR_READS], denied[REGISTER_USE_GPR_WRITES], denied[REGISTER_USE_FPR_READS], denied[REGISTER_USE_FPR_WRITES]};
+  }
+
+  /// @brief Whether the ... before line may consume insn, given the register constraints of the thread waiting on it
+  template< class DialectT >
+  bool isInsnSkippable(uint32_t lineIdx, uint32_t insn, DialectT dialect, const RegisterConstraints& constraints) const {
+    if (table->lines[lineIdx].numRegisters == 0) return true;
+    RegisterUse use;
+    if (!lookupRegisterUse(table->registerFields, table->registerFieldsBuckets, insn, dialect, use)) return true; // not a valid instruction (e.g. data)
+    return constraints.allows(use);
+  }
+
+  /// @brief Whether insn matches line, binding the variables it captures in ctx
+  template< class DialectT, class Getter >
+  bool isInsnMatching(uint32_t lineIdx, uint64_t insn, DialectT dialect, std::byte* ctx, uint32_t vma, const Getter& symbolGetter) const {
+    const LineEntry& line = table->lines[lineIdx];
+    const ContextLayout& layout = table->layout;
+    // the mnemonic and the defined operands are all fixed bits of the instruction
+    if ((insn & line.mask) != line.value || !isOpcodeInDialect(line.opcodeFlags, line.opcodeDeprecated, dialect)) return false;
+
+    // variables bound by this line are unbound again if one of its operands does not match
+    const BoundMasks bound = boundMasks(ctx);
+    bool isMatching = true;
+    for (uint32_t idx = line.firstOperand; isMatching && idx < line.firstOperand + line.numOperands; idx++) {
+      const OperandEntry& operand = table->operands[idx];
+      switch (operand.action) {
+      case OperandAction::BindGpr:
+        isMatching = bindOrCompare<uint32_t>(ctx, layout.gprs, layout.gprsBound, operand.var, extractOperand(operand, insn, dialect));
+        break;
+      case OperandAction::BindFpr:
+        isMatching = bindOrCompare<uint32_t>(ctx, layout.fprs, layout.fprsBound, operand.var, extractOperand(operand, insn, dialect));
+        break;
+      case OperandAction::BindImm:
+        isMatching = bindOrCompare<int32_t>(ctx, layout.imms, layout.immsBound, operand.var, extractOperand(operand, insn, dialect));
+        break;
+      case OperandAction::BindLab:
+      case OperandAction::CompareLabel:
+        isMatching = isLabelMatching(operand, vma, symbolGetter, ctx);
+        break;
+      case OperandAction::CompareValue:
+        isMatching = extractOperand(operand, insn, dialect) == operand.value;
+        break;
+      case OperandAction::OptionalValue:
+        isMatching = extractOperand(operand, insn, dialect) ==
+                     ppcdisasm::ppc_optional_operand_value(powerpc_operands + operand.operandIdx, insn, dialect, operand.value);
+        break;
+      }
+    }
+    if (!isMatching) restoreBoundMasks(ctx, bound);
+    return isMatching;
+  }
+
+private:
+  const IdiomTable* table;
+
+  // the members of the contexts are copied in and out, as the interpreter only knows their offsets
+  template< class T >
+  static T load(const std::byte* ptr) {
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+  }
+
+  template< class T >
+  static void store(std::byte* ptr, const T& value) { std::memcpy(ptr, &value, sizeof(T)); }
+
+  template< class T >
+  static bool sameBoundSlots(const std::byte* ctx, const std::byte* other, uint32_t slots, uint32_t boundOffset) {
+    uint64_t bound = load<uint64_t>(ctx + boundOffset);
+    if (bound != load<uint64_t>(other + boundOffset)) return false;
+    for (; bound != 0; bound &= bound - 1) {
+      uint32_t offset = slots + std::countr_zero(bound) * sizeof(T);
+      if (load<T>(ctx + offset) != load<T>(other + offset)) return false;
+    }
+    return true;
+  }
+
+  template< class T >
+  static uint64_t hashBoundSlots(uint64_t hash, const std::byte* ctx, uint32_t slots, uint32_t boundOffset) {
+    for (uint64_t bound = load<uint64_t>(ctx + boundOffset); bound != 0; bound &= bound - 1) {
+      T slot = load<T>(ctx + slots + std::countr_zero(bound) * sizeof(T));
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        hash = hashCombine(hash, std::hash<std::string_view>()(slot));
+      } else {
+        hash = hashCombine(hash, static_cast<uint32_t>(slot));
+      }
+    }
+    return hash;
+  }
+
+  static int64_t extractOperand(const OperandEntry& operand, uint64_t insn, ppc_cpu_t dialect) {
+    if (operand.usesExtractFn) return ppcdisasm::operand_value_powerpc(powerpc_operands + operand.operandIdx, insn, dialect);
+    uint64_t field = operand.shift >= 0 ? (insn >> operand.shift) & operand.bitm : (insn << -operand.shift) & operand.bitm;
+    return static_cast<int64_t>(field ^ operand.signBit) - static_cast<int64_t>(operand.signBit);
+  }
+
+  template< class T >
+  static bool bindOrCompare(std::byte* ctx, uint32_t slots, uint32_t boundOffset, uint8_t var, int64_t value) {
+    uint64_t bound = load<uint64_t>(ctx + boundOffset);
+    if (bound & (1ull << var)) return value == load<T>(ctx + slots + var * sizeof(T));
+    store(ctx + slots + var * sizeof(T), static_cast<T>(value));
+    store(ctx + boundOffset, bound | (1ull << var));
+    return true;
+  }
+
+  template< class Getter >
+  bool isLabelMatching(const OperandEntry& operand, uint32_t vma, const Getter& symbolGetter, std::byte* ctx) const {
+    const ContextLayout& layout = table->layout;
+    const auto& relocTarget = symbolGetter(vma);
+    if (operand.relocKind >= 0 && symbolKind(relocTarget) != operand.relocKind) return false;
+    if (operand.action == OperandAction::CompareLabel) return symbolName(relocTarget) == operand.label;
+    uint32_t slot = layout.labs + operand.var * sizeof(std::string_view);
+    uint64_t bound = load<uint64_t>(ctx + layout.labsBound);
+    if (bound & (1ull << operand.var)) return symbolName(relocTarget) == load<std::string_view>(ctx + slot);
+    store(ctx + slot, std::string_view(symbolName(relocTarget)));
+    store(ctx + layout.labsBound, bound | (1ull << operand.var));
+    return true;
+  }
+};
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "opcode/ppc.h"
+#include "ppcdisasm/ppc-dis.hpp"
+
+#include "aipg/generator.hpp"
+#include "aipg/prefilter.hpp"
+#include "aipg/scan.hpp"
+#include "aipg/symbols.hpp"
+
+namespace aipg {
+/// @brief A match yielded by aipg::matches. parseCtx is reused by the next match, copy it if you need to keep it
+template< class Context >
+struct IdiomMatch {
+  uint32_t startIdx;
+  const Context& parseCtx;
+};
+
+/// @brief Lazily scans ins for the idiom described by Idiom (the struct generated along with match<Idiom>), yielding one match at a time.
+/// Nothing past the last match consumed is scanned, so stopping early skips the rest of the input.
+/// symbolGetter is taken by value, as the generator may outlive the arguments
+template< class Idiom, class Getter = DefaultSymbolGetter >
+Generator<IdiomMatch<typename Idiom::Context>> matches(std::span<const uint32_t> ins, ppc_cpu_t dialect, uint32_t memaddr=0x0,
+                                                       Getter symbolGetter=ppcdisasm::defaultSymbolGetter) {
+  typename Idiom::Nfa nfa;
+  typename Idiom::Context parseCtx;
+  auto stableGetter = stableSymbolGetter<Idiom::numLabs != 0>(symbolGetter);
+  const uint32_t* begin = ins.data();
+  const uint32_t* end = begin + ins.size();
+
+  for (const uint32_t* candidate = prefilter::find(begin, end, Idiom::anchorMask, Idiom::anchorValue); candidate != end;
+       candidate = prefilter::find(candidate + 1, end, Idiom::anchorMask, Idiom::anchorValue)) {
+    uint32_t startIdx = candidate - begin;
+    parseCtx.clear();
+    if (matchWithNfa<Idiom>(nfa, candidate, end, dialect, parseCtx, memaddr+4*startIdx, stableGetter))
+      co_yield IdiomMatch<typename Idiom::Context>{startIdx, parseCtx};
+  }
+}
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aipg/aipg.hpp"
+#include "aipg/boundaries.hpp"
+#include "aipg/registers.hpp"
+
+namespace aipg {
+/// @brief How PikeNfa reaches a line of an idiom. Program::line may return any type with these members, such as aipg::LineEntry
+struct NfaLine {
+  // the line is preceded by a ...
+  bool isGap;
+  // the ... stops at function exits and symbol starts
+  bool gapStopsAtFunctionEnd;
+  // number of instructions the ... must and may consume
+  uint32_t gapMin;
+  uint32_t gapMax;
+};
+
+/// @brief Pike VM simulation of an idiom. Each thread is a partial match waiting on one of the idiom's lines with its own captures,
+/// so every way of consuming instructions with ... is explored in a single forward pass over the input.
+/// Program describes and checks the idiom's lines: the code generated for each idiom by the default backend, or the aipg::TableProgram
+/// shared by all idioms of the table backend. The captures are program.contextSize() bytes that only Program interprets, so the
+/// simulation itself does not depend on the idiom's context type
+template< class Program >
+class PikeNfa {
+public:
+  explicit PikeNfa(Program program) : program(std::move(program)), contextSize(this->program.contextSize()) {}
+
+  /// @brief Starts a new match attempt with a single thread waiting on the first line, with the captures of parseCtx
+  template< class Context >
+  void start(const Context& parseCtx) {
+    static_assert(std::is_trivially_copyable_v<Context>, "the captures are copied between threads as bytes");
+    const std::byte* ctx = reinterpret_cast<const std::byte*>(&parseCtx);
+    current.clear();
+    queue(current, 0, 0, program.gapConstraints(0, ctx), ctx);
+  }
+
+  /// @brief True once no thread is left, i.e. the attempt failed
+  bool isDead() const { return current.threads.empty(); }
+
+  /// @brief Captures of the completed match, valid after step returned true. Context must be the type passed to start
+  template< class Context >
+  Context& matched() { return *std::launder(reinterpret_cast<Context*>(matchedCtx.data())); }
+
+  /// @brief Feeds the instruction at insIdx to all threads. Returns true as soon as a thread completes the idiom,
+  /// trying threads in priority order (matching a line takes priority over consuming the instruction with ...)
+  template< class DialectT, class Getter >
+  bool step(uint32_t insn, uint32_t insIdx, uint32_t vma, DialectT dialect, const Getter& symbolGetter) {
+    next.clear();
+    for (size_t idx = 0; idx < current.threads.size(); idx++) {
+      Thread& thread = current.threads[idx];
+      std::byte* ctx = current.context(idx, contextSize);
+      const auto& line = program.line(thread.line);
+      if (line.isGap) {
+        if (thread.gapLen >= line.gapMin) {
+          const BoundMasks bound = program.boundMasks(ctx);
+          if (program.isInsnMatching(thread.line, insn, dialect, ctx, vma, symbolGetter)) {
+            program.setMatchInsIdx(ctx, thread.line, insIdx);
+            if (advance(thread.line + 1, ctx)) return true;
+            // the thread also goes on skipping the instruction, with the bindings it had before this line
+            program.restoreBoundMasks(ctx, bound);
+          }
+        }
+        if (thread.gapLen < line.gapMax
+            && (!line.gapStopsAtFunctionEnd || !isFunctionBoundary(insn, vma, symbolGetter))
+            && program.isInsnSkippable(thread.line, insn, dialect, thread.gapConstraints)) {
+          // past the minimum of an unbounded gap, the exact length no longer matters
+          bool isLengthIrrelevant = line.gapMax == UINT32_MAX && thread.gapLen >= line.gapMin;
+          add(thread.line, isLengthIrrelevant ? thread.gapLen : thread.gapLen + 1, thread.gapConstraints, ctx);
+        }
+      } else if (program.isInsnMatching(thread.line, insn, dialect, ctx, vma, symbolGetter)) {
+        program.setMatchInsIdx(ctx, thread.line, insIdx);
+        if (advance(thread.line + 1, ctx)) return true;
+      }
+    }
+    std::swap(current, next);
+    return false;
+  }
+
+private:
+  struct Thread {
+    uint32_t line;
+    // number of instructions consumed by the ... before line
+    uint32_t gapLen;
+    // registers the instructions consumed by the ... before line must not access, fixed once the thread reaches it
+    RegisterConstraints gapConstraints;
+    // hash of line, gapLen and the bound variables, which make threads equivalent
+    uint64_t hash;
+  };
+
+  // threads in priority order, the captures of thread n are the n-th contextSize bytes of contexts.
+  // An open addressing hash set of the threads finds an equivalent one in constant time, however many there are
+  struct ThreadList {
+    std::vector<Thread> threads;
+    std::vector<std::byte> contexts;
+    // index + 1 of the thread in each bucket, 0 when empty. Its size is a power of two at least twice the number of threads
+    std::vector<uint32_t> buckets = std::vector<uint32_t>(16);
+
+    std::byte* context(size_t idx, size_t contextSize) { return contexts.data() + idx * contextSize; }
+
+    void clear() {
+      if (!threads.empty()) std::fill(buckets.begin(), buckets.end(), 0);
+      threads.clear();
+    }
+
+    // bucket of the thread equivalent to the one described, or the empty bucket where it would go
+    template< class IsSame >
+    uint32_t& find(uint64_t hash, IsSame isSame) {
+      size_t mask = buckets.size() - 1;
+      for (size_t bucket = hash & mask;; bucket = (bucket + 1) & mask) {
+        uint32_t& entry = buckets[bucket];
+        if (entry == 0 || (threads[entry - 1].hash == hash && isSame(entry - 1))) return entry;
+      }
+    }
+
+    void push(uint32_t& bucket, const Thread& thread, const std::byte* ctx, size_t contextSize) {
+      size_t end = (threads.size() + 1) * contextSize;
+      // grown rather than resized to fit, the storage is kept for the next instructions and match attempts
+      if (contexts.size() < end) contexts.resize(std::max(end, 2 * contexts.size()));
+      std::memcpy(contexts.data() + threads.size() * contextSize, ctx, contextSize);
+      threads.push_back(thread);
+      bucket = threads.size();
+      if (2 * threads.size() > buckets.size()) rehash();
+    }
+
+    void rehash() {
+      buckets.assign(2 * buckets.size(), 0);
+      size_t mask = buckets.size() - 1;
+      for (uint32_t idx = 0; idx < threads.size(); idx++) {
+        size_t bucket = threads[idx].hash & mask;
+        while (buckets[bucket] != 0) bucket = (bucket + 1) & mask;
+        buckets[bucket] = idx + 1;
+      }
+    }
+  };
+
+  Program program;
+  size_t contextSize;
+  // threads for the current and the next instruction
+  ThreadList current;
+  ThreadList next;
+  std::vector<std::byte> matchedCtx;
+
+  bool advance(uint32_t line, const std::byte* ctx) {
+    if (line == program.numLines()) {
+      matchedCtx.resize(contextSize);
+      std::memcpy(matchedCtx.data(), ctx, contextSize);
+      return true;
+    }
+    add(line, 0, program.gapConstraints(line, ctx), ctx);
+    return false;
+  }
+
+  // queues a thread for the next instruction, unless an equivalent one of higher priority is already queued
+  void add(uint32_t line, uint32_t gapLen, const RegisterConstraints& constraints, const std::byte* ctx) {
+    queue(next, line, gapLen, constraints, ctx);
+  }
+
+  // threads are only merged when equivalent, so every distinct partial match is kept. Their number is finite, as the length of an
+  // unbounded ... stops counting past its minimum
+  void queue(ThreadList& list, uint32_t line, uint32_t gapLen, const RegisterConstraints& constraints, const std::byte* ctx) {
+    uint64_t hash = hashCombine(hashCombine(program.hashBindings(ctx), line), gapLen);
+    uint32_t& bucket = list.find(hash, [&](uint32_t idx) {
+      const Thread& thread = list.threads[idx];
+      return thread.line == line && thread.gapLen == gapLen && program.hasSameBindings(list.context(idx, contextSize), ctx);
+    });
+    if (bucket == 0) list.push(bucket, {line, gapLen, constraints, hash}, ctx, contextSize);
+  }
+};
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace aipg {
+/// @brief Scans the start positions [0, count) in contiguous chunks on numThreads threads (0 for one per hardware thread).
+/// scanChunk(chunkFirst, chunkLast, results) must append the matches starting in [chunkFirst, chunkLast) to results, it may read
+/// instructions past chunkLast so that matches crossing into the next chunk are still found by the chunk they start in.
+/// Once all chunks are done, results are replayed to callback in chunk order, so they arrive in address order.
+template< class Result, class ScanChunk, class Callback >
+void parallelScan(uint32_t count, unsigned numThreads, ScanChunk scanChunk, Callback callback) {
+  if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+  // more chunks than threads, so that threads that finish early pick up more work
+  uint32_t numChunks = std::max(1u, std::min<uint32_t>(count, numThreads * 8));
+  uint32_t chunkSize = (count + numChunks - 1) / std::max(1u, numChunks);
+  std::vector<std::vector<Result>> chunkResults(numChunks);
+
+  std::atomic<uint32_t> nextChunk = 0;
+  auto worker = [&]() {
+    for (uint32_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+      uint32_t chunkFirst = std::min(count, chunk * chunkSize);
+      uint32_t chunkLast = std::min(count, chunkFirst + chunkSize);
+      scanChunk(chunkFirst, chunkLast, chunkResults[chunk]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < std::min(numThreads, numChunks); i++)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  for (std::vector<Result>& results : chunkResults) {
+    for (Result& result : results)
+      callback(result);
+  }
+}
+}
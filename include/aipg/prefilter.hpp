@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "aipg/bigendian.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define AIPG_PREFILTER_X86
+#endif
+
+namespace aipg {
+namespace prefilter {
+// The implementations work on the bytes of host order words, which need not be aligned, so that they also serve big-endian images
+
+/// @brief Signature of the implementations of find, on [first, last) as bytes
+using FindFn = const std::byte* (*)(const std::byte* first, const std::byte* last, uint32_t mask, uint32_t value);
+
+/// @brief Portable implementation of find, one word at a time
+inline const std::byte* findScalar(const std::byte* first, const std::byte* last, uint32_t mask, uint32_t value) {
+  for (; last - first >= 4; first += 4) {
+    uint32_t word;
+    std::memcpy(&word, first, sizeof(word));
+    if ((word & mask) == value) return first;
+  }
+  return last;
+}
+
+#ifdef AIPG_PREFILTER_X86
+/// @brief SSE2 implementation of find, 4 words at a time
+__attribute__((target("sse2")))
+inline const std::byte* findSse2(const std::byte* first, const std::byte* last, uint32_t mask, uint32_t value) {
+  const __m128i vmask = _mm_set1_epi32(mask);
+  const __m128i vvalue = _mm_set1_epi32(value);
+  for (; last - first >= 16; first += 16) {
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(words, vmask), vvalue);
+    int hits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+    if (hits != 0) return first + 4*__builtin_ctz(hits);
+  }
+  return findScalar(first, last, mask, value);
+}
+
+/// @brief AVX2 implementation of find, 8 words at a time
+__attribute__((target("avx2")))
+inline const std::byte* findAvx2(const std::byte* first, const std::byte* last, uint32_t mask, uint32_t value) {
+  const __m256i vmask = _mm256_set1_epi32(mask);
+  const __m256i vvalue = _mm256_set1_epi32(value);
+  for (; last - first >= 32; first += 32) {
+    __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(words, vmask), vvalue);
+    int hits = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    if (hits != 0) return first + 4*__builtin_ctz(hits);
+  }
+  return findScalar(first, last, mask, value);
+}
+#endif
+
+/// @brief Picks the widest implementation supported by the running CPU
+inline FindFn resolveFind() {
+#ifdef AIPG_PREFILTER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return findAvx2;
+  if (__builtin_cpu_supports("sse2")) return findSse2;
+#endif
+  return findScalar;
+}
+
+inline const std::byte* findBytes(const std::byte* first, const std::byte* last, uint32_t mask, uint32_t value) {
+  static const FindFn findImpl = resolveFind();
+  return findImpl(first, last, mask, value);
+}
+
+/// @brief Returns the first word in [first, last) for which (word & mask) == value, or last if there is none
+inline const uint32_t* find(const uint32_t* first, const uint32_t* last, uint32_t mask, uint32_t value) {
+  const std::byte* found = findBytes(reinterpret_cast<const std::byte*>(first), reinterpret_cast<const std::byte*>(last), mask, value);
+  return first + (found - reinterpret_cast<const std::byte*>(first)) / 4;
+}
+
+/// @brief Same as find, over the big-endian words of an image. Rather than swapping every word, mask and value are swapped to host order
+inline BigEndianWordIterator findBigEndian(BigEndianWordIterator first, BigEndianWordIterator last, uint32_t mask, uint32_t value) {
+  return BigEndianWordIterator(findBytes(first.base(), last.base(), fromBigEndian(mask), fromBigEndian(value)));
+}
+}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opcode/ppc.h"
+
+#include "aipg/dialect.hpp"
+
+namespace aipg {
+/// @brief Registers an instruction reads and writes, bit n stands for rn (or fn)
+struct RegisterUse {
+  uint32_t gprReads;
+  uint32_t gprWrites;
+  uint32_t fprReads;
+  uint32_t fprWrites;
+};
+
+/// @brief Registers that the instructions consumed by a ... must not access, compiled from its constraints once the variables
+/// they mention are bound: both the registers listed after ^ and, if the constraint lists allowed registers, all the others
+struct RegisterConstraints {
+  uint32_t gprReadsDenied = 0;
+  uint32_t gprWritesDenied = 0;
+  uint32_t fprReadsDenied = 0;
+  uint32_t fprWritesDenied = 0;
+
+  constexpr bool allows(const RegisterUse& use) const {
+    return ((use.gprReads & gprReadsDenied) | (use.gprWrites & gprWritesDenied) |
+            (use.fprReads & fprReadsDenied) | (use.fprWrites & fprWritesDenied)) == 0;
+  }
+};
+
+/// @brief Register operands of an opcode, as up to 4 fields packed one per byte in each of the masks:
+/// bits 0-4 hold the field's shift, the REGISTER_FIELD_* flags the rest
+struct OpcodeRegisterFields {
+  uint32_t mask;
+  uint32_t value;
+  ppc_cpu_t flags;
+  ppc_cpu_t deprecated;
+  uint32_t gprReads;
+  uint32_t gprWrites;
+  uint32_t fprReads;
+  uint32_t fprWrites;
+};
+
+/// @brief Set on every field, so that a field with a shift of 0 is not mistaken for no field
+constexpr uint32_t REGISTER_FIELD_PRESENT = 0x80;
+/// @brief A value of 0 stands for the literal 0 instead of r0 (PPC_OPERAND_GPR_0)
+constexpr uint32_t REGISTER_FIELD_ZERO_IS_NONE = 0x40;
+/// @brief The field names the first of the registers up to r31, e.g. lmw and stmw
+constexpr uint32_t REGISTER_FIELD_THROUGH_R31 = 0x20;
+/// @brief Both flags at once, which no other field has: the field names the first of a range whose length the field does not
+/// give, e.g. lswi and stswx, so any register may be accessed
+constexpr uint32_t REGISTER_FIELD_ALL = REGISTER_FIELD_ZERO_IS_NONE | REGISTER_FIELD_THROUGH_R31;
+
+/// @brief Registers named by the packed fields in insn
+constexpr uint32_t registerFieldsMask(uint32_t fields, uint32_t insn) {
+  uint32_t registers = 0;
+  for (; fields != 0; fields >>= 8) {
+    uint32_t field = fields & 0xff;
+    if ((field & REGISTER_FIELD_PRESENT) == 0) continue;
+    if ((field & REGISTER_FIELD_ALL) == REGISTER_FIELD_ALL) return ~0u;
+    uint32_t reg = (insn >> (field & 0x1f)) & 0x1f;
+    if ((field & REGISTER_FIELD_ZERO_IS_NONE) != 0 && reg == 0) continue;
+    registers |= (field & REGISTER_FIELD_THROUGH_R31) != 0 ? ~0u << reg : 1u << reg;
+  }
+  return registers;
+}
+
+/// @brief Looks up the first opcode of table matching insn in dialect, like lookup_powerpc, among the ones of its primary opcode.
+/// Entries of primary opcode p are table[bucketStarts[p]] to table[bucketStarts[p+1]]. Returns false if none matches, e.g. for data
+template< class DialectT >
+constexpr bool lookupRegisterUse(const OpcodeRegisterFields* table, const uint16_t* bucketStarts, uint32_t insn, DialectT dialect, RegisterUse& use) {
+  uint32_t primaryOpcode = insn >> 26;
+  for (uint32_t idx = bucketStarts[primaryOpcode]; idx < bucketStarts[primaryOpcode + 1]; idx++) {
+    const OpcodeRegisterFields& opcode = table[idx];
+    if ((insn & opcode.mask) != opcode.value || !isOpcodeInDialect(opcode.flags, opcode.deprecated, dialect)) continue;
+    use.gprReads = registerFieldsMask(opcode.gprReads, insn);
+    use.gprWrites = registerFieldsMask(opcode.gprWrites, insn);
+    use.fprReads = registerFieldsMask(opcode.fprReads, insn);
+    use.fprWrites = registerFieldsMask(opcode.fprWrites, insn);
+    return true;
+  }
+  return false;
+}
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ppcdisasm/ppc-relocations.h"
+
+#include "aipg/symbols.hpp"
+
+namespace aipg {
+/// @brief A relocation (or, with kind R_PPC_NONE, the start of a symbol) at vma, as given to RelocationIndex
+struct Relocation {
+  uint32_t vma;
+  int kind;
+  std::string name;
+};
+
+/// @brief Symbol getter over a fixed set of relocations, e.g. those of a section, to pass to the generated matchers.
+/// Relocations are kept sorted by vma in flat arrays and looked up with a branch-free binary search. Names are interned:
+/// each distinct name is stored once and identified by a symbol id, so that lookups neither allocate nor copy names
+class RelocationIndex {
+public:
+  static constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+
+  RelocationIndex() = default;
+
+  /// @brief Indexes relocations, of which only the first one given for each vma is kept
+  explicit RelocationIndex(std::vector<Relocation> relocations) {
+    std::stable_sort(relocations.begin(), relocations.end(), [](const Relocation& a, const Relocation& b) { return a.vma < b.vma; });
+    std::unordered_map<std::string, uint32_t> symbolIds;
+    for (Relocation& relocation : relocations) {
+      if (!vmas.empty() && vmas.back() == relocation.vma) continue;
+      auto [it, isNew] = symbolIds.try_emplace(relocation.name, names.size());
+      if (isNew) names.push_back(std::move(relocation.name));
+      vmas.push_back(relocation.vma);
+      kinds.push_back(relocation.kind);
+      ids.push_back(it->second);
+    }
+  }
+
+  /// @brief Position of the relocation at vma in the flat arrays, or size() if there is none
+  size_t find(uint32_t vma) const {
+    if (vmas.empty()) return 0;
+    const uint32_t* base = vmas.data();
+    // each step keeps the half that holds the last vma <= the searched one, which compiles to a conditional move
+    for (size_t count = vmas.size(); count > 1; count -= count / 2)
+      base = base[count / 2] <= vma ? base + count / 2 : base;
+    return *base == vma ? base - vmas.data() : vmas.size();
+  }
+
+  /// @brief Relocation kind at vma, R_PPC_NONE if there is none
+  int kind(uint32_t vma) const {
+    size_t idx = find(vma);
+    return idx != vmas.size() ? kinds[idx] : R_PPC_NONE;
+  }
+
+  /// @brief Id of the symbol targeted at vma, NO_SYMBOL if there is none. Relocations to the same name share an id
+  uint32_t symbolId(uint32_t vma) const {
+    size_t idx = find(vma);
+    return idx != vmas.size() ? ids[idx] : NO_SYMBOL;
+  }
+
+  /// @brief Name of the symbol with id symbolId
+  std::string_view symbolName(uint32_t symbolId) const { return names[symbolId]; }
+
+  /// @brief Number of distinct symbol names
+  size_t numSymbols() const { return names.size(); }
+
+  /// @brief Number of relocations indexed
+  size_t size() const { return vmas.size(); }
+
+  SymbolView operator()(uint32_t vma) const {
+    size_t idx = find(vma);
+    if (idx == vmas.size()) return {R_PPC_NONE, {}};
+    return {kinds[idx], names[ids[idx]]};
+  }
+
+private:
+  std::vector<uint32_t> vmas;
+  std::vector<int> kinds;
+  std::vector<uint32_t> ids;
+  std::vector<std::string> names;
+};
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "opcode/ppc.h"
+
+#include "aipg/bigendian.hpp"
+#include "aipg/parallel.hpp"
+#include "aipg/prefilter.hpp"
+#include "aipg/symbols.hpp"
+
+// Algorithms shared by the generated matchers. Idiom is the struct generated for each idiom along with match<Idiom>,
+// which names its Context and Nfa types and the bits fixed by its first line
+namespace aipg {
+/// @brief Matches the idiom at first, reusing the storage of nfa
+template< class Idiom, class ForwardIt, class DialectT, class Getter >
+bool matchWithNfa(typename Idiom::Nfa& nfa, ForwardIt first, ForwardIt last, DialectT dialect, typename Idiom::Context& parseCtx, uint32_t memaddr,
+                  const Getter& symbolGetter) {
+  if (Idiom::Nfa::numLines == 0) return true;
+  nfa.start(parseCtx);
+  uint32_t insIdx = 0;
+  for (ForwardIt iter = first; iter != last && !nfa.isDead(); iter++, insIdx++) {
+    if (nfa.step(*iter, insIdx, memaddr+4*insIdx, dialect, symbolGetter)) {
+      parseCtx = nfa.matchedCtx();
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief Scans the start positions [startFirst, startLast) of [first, last) for the idiom, matches may extend up to last.
+/// The positions whose instruction has the idiom's anchor bits are searched for, and a match attempt runs from each one until it matches
+/// or fails, so the cost is the number of candidates times the instructions each attempt reads, which are bounded by the idiom's maxMatchLength.
+/// Callback is invoked as callback(uint32_t startIdx, const Idiom::Context& parseCtx) for every match found
+template< class Idiom, class ForwardIt, class DialectT, class Getter, class Callback >
+void scanStarts(ForwardIt first, ForwardIt last, uint32_t startFirst, uint32_t startLast, DialectT dialect, uint32_t memaddr, const Getter& symbolGetter,
+                Callback callback) {
+  using Context = typename Idiom::Context;
+  typename Idiom::Nfa nfa;
+  Context parseCtx;
+  // the labels captured are views of names that live until the end of the scan
+  auto stableGetter = stableSymbolGetter<Idiom::numLabs != 0>(symbolGetter);
+
+  if constexpr (std::contiguous_iterator<ForwardIt> && std::is_same_v<std::iter_value_t<ForwardIt>, uint32_t>) {
+    // vectorized search for candidate start positions, the full check only runs where the anchor matches
+    const uint32_t* begin = std::to_address(first);
+    const uint32_t* startsEnd = begin + std::min<size_t>(startLast, last - first);
+    for (const uint32_t* candidate = prefilter::find(begin + startFirst, startsEnd, Idiom::anchorMask, Idiom::anchorValue); candidate != startsEnd;
+         candidate = prefilter::find(candidate + 1, startsEnd, Idiom::anchorMask, Idiom::anchorValue)) {
+      uint32_t startIdx = candidate - begin;
+      parseCtx.clear();
+      if (matchWithNfa<Idiom>(nfa, first + startIdx, last, dialect, parseCtx, memaddr+4*startIdx, stableGetter))
+        callback(startIdx, static_cast<const Context&>(parseCtx));
+    }
+  } else if constexpr (std::is_same_v<ForwardIt, BigEndianWordIterator>) {
+    // same search over the raw image, the prefilter compares byte-swapped anchor bits instead of swapping every word
+    BigEndianWordIterator startsEnd = first + std::min<size_t>(startLast, last - first);
+    for (BigEndianWordIterator candidate = prefilter::findBigEndian(first + startFirst, startsEnd, Idiom::anchorMask, Idiom::anchorValue);
+         candidate != startsEnd; candidate = prefilter::findBigEndian(candidate + 1, startsEnd, Idiom::anchorMask, Idiom::anchorValue)) {
+      uint32_t startIdx = candidate - first;
+      parseCtx.clear();
+      if (matchWithNfa<Idiom>(nfa, candidate, last, dialect, parseCtx, memaddr+4*startIdx, stableGetter))
+        callback(startIdx, static_cast<const Context&>(parseCtx));
+    }
+  } else {
+    uint32_t startIdx = startFirst;
+    for (ForwardIt iter = std::next(first, startFirst); iter != last && startIdx < startLast; iter++, startIdx++) {
+      if ((*iter & Idiom::anchorMask) != Idiom::anchorValue) continue;
+      parseCtx.clear();
+      if (matchWithNfa<Idiom>(nfa, iter, last, dialect, parseCtx, memaddr+4*startIdx, stableGetter))
+        callback(startIdx, static_cast<const Context&>(parseCtx));
+    }
+  }
+}
+
+/// @brief Same as scanStarts over all of [first, last), split into chunks that are scanned on numThreads threads, see aipg::parallelScan
+template< class Idiom, class RandomIt, class DialectT, class Getter, class Callback >
+void scanStartsParallel(RandomIt first, RandomIt last, DialectT dialect, uint32_t memaddr, const Getter& symbolGetter, Callback callback,
+                        unsigned numThreads) {
+  using Result = std::pair<uint32_t, typename Idiom::Context>;
+  // shared by all chunks, as their results are reported once all are done
+  auto stableGetter = stableSymbolGetter<Idiom::numLabs != 0>(symbolGetter);
+  parallelScan<Result>(last - first, numThreads,
+    [&](uint32_t chunkFirst, uint32_t chunkLast, std::vector<Result>& results) {
+      scanStarts<Idiom>(first, last, chunkFirst, chunkLast, dialect, memaddr, stableGetter,
+        [&](uint32_t startIdx, const typename Idiom::Context& parseCtx) { results.emplace_back(startIdx, parseCtx); });
+    },
+    [&](const Result& result) { callback(result.first, result.second); });
+}
+
+/// @brief Scans instructions that are fed in pieces for the idiom, keeping partial matches across pieces.
+/// An attempt is given up once it spans maxMatchLength instructions without matching, so at most maxMatchLength attempts
+/// (and their NFAs) are kept in memory, however long the input. Idioms with an unbounded ... have no such length of their own,
+/// it must then be passed to the constructor and matches spanning more instructions are missed.
+/// Callback is invoked as callback(uint32_t startIdx, const Idiom::Context& parseCtx) for every match found, in order of startIdx
+template< class Idiom, class Callback, class Getter >
+class StreamScanner {
+public:
+  using Context = typename Idiom::Context;
+  using Nfa = typename Idiom::Nfa;
+
+  StreamScanner(ppc_cpu_t dialect, uint32_t memaddr, Getter symbolGetter, Callback callback) requires (Idiom::maxMatchLength != UINT32_MAX)
+    : StreamScanner(dialect, memaddr, std::move(symbolGetter), std::move(callback), Idiom::maxMatchLength) {}
+
+  /// @brief maxMatchLength may also be lower than the idiom's own to keep less in memory, at the cost of missing the longer matches
+  StreamScanner(ppc_cpu_t dialect, uint32_t memaddr, Getter symbolGetter, Callback callback, uint32_t maxMatchLength)
+    : dialect(dialect), memaddr(memaddr), maxMatchLength(std::min(maxMatchLength, Idiom::maxMatchLength)), symbolGetter(std::move(symbolGetter)),
+      callback(std::move(callback)) {}
+
+  /// @brief Number of attempts in flight or waiting on an earlier one to be reported, at most maxMatchLength
+  size_t numPendingAttempts() const { return attempts.size(); }
+
+  /// @brief Scans the next count instructions of the input
+  void feed(const uint32_t* ins, size_t count) {
+    for (const uint32_t* iter = ins; iter != ins + count; iter++, insIdx++) {
+      uint32_t insn = *iter;
+      if ((insn & Idiom::anchorMask) == Idiom::anchorValue) {
+        attempts.push_back({insIdx, Attempt::Running, takeNfa()});
+        attempts.back().nfa.start(Context());
+        if (Nfa::numLines == 0) attempts.back().status = Attempt::Matched;
+      }
+
+      for (Attempt& attempt : attempts) {
+        if (attempt.status != Attempt::Running) continue;
+        if (attempt.nfa.step(insn, insIdx - attempt.startIdx, memaddr+4*insIdx, dialect, symbolGetter)) {
+          attempt.status = Attempt::Matched;
+        } else if (attempt.nfa.isDead() || insIdx + 1 - attempt.startIdx >= maxMatchLength) {
+          // no match of at most maxMatchLength instructions is left
+          attempt.status = Attempt::Failed;
+        }
+      }
+      reportFinished();
+    }
+  }
+
+  /// @brief Ends the input. Attempts still in flight fail, after which the scanner may be fed a new input starting at memaddr
+  void finish() {
+    for (Attempt& attempt : attempts) {
+      if (attempt.status == Attempt::Running) attempt.status = Attempt::Failed;
+    }
+    reportFinished();
+    insIdx = 0;
+  }
+
+private:
+  struct Attempt {
+    uint32_t startIdx;
+    enum { Running, Matched, Failed } status;
+    Nfa nfa;
+  };
+
+  ppc_cpu_t dialect;
+  uint32_t memaddr;
+  uint32_t maxMatchLength;
+  StableSymbolGetter<Getter, Idiom::numLabs != 0> symbolGetter;
+  Callback callback;
+  // index of the next instruction fed
+  uint32_t insIdx = 0;
+  // match attempts that are in flight or wait on an earlier one to be reported, in order of startIdx
+  std::deque<Attempt> attempts;
+  // finished NFAs, kept to reuse their storage
+  std::vector<Nfa> nfaPool;
+
+  Nfa takeNfa() {
+    if (nfaPool.empty()) return Nfa();
+    Nfa nfa = std::move(nfaPool.back());
+    nfaPool.pop_back();
+    return nfa;
+  }
+
+  void reportFinished() {
+    while (!attempts.empty() && attempts.front().status != Attempt::Running) {
+      Attempt& attempt = attempts.front();
+      if (attempt.status == Attempt::Matched)
+        callback(attempt.startIdx, static_cast<const Context&>(attempt.nfa.matchedCtx()));
+      nfaPool.push_back(std::move(attempt.nfa));
+      attempts.pop_front();
+    }
+  }
+};
+}
\ No newline at end of file
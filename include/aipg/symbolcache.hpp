@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace aipg {
+/// @brief Symbol getter that memoizes the results of another one in a direct-mapped cache keyed by vma, so that the label
+/// operands tested again at the same address (by several idioms, or several candidate start positions) resolve it once.
+/// Word n of the section maps to slot n modulo numSlots, so a section of at most numSlots instructions never evicts a result.
+/// Lookups update the cache, so a SymbolCache must not be shared between threads, e.g. in scanParallel
+template< class Getter >
+class SymbolCache {
+public:
+  using Result = std::decay_t<std::invoke_result_t<const Getter&, uint32_t>>;
+
+  /// @brief numSlots is rounded up to a power of two
+  explicit SymbolCache(Getter getter, uint32_t numSlots=4096) : getter(std::move(getter)) {
+    uint32_t size = 1;
+    while (size < numSlots) size *= 2;
+    slots.resize(size);
+  }
+
+  const Result& operator()(uint32_t vma) const {
+    Slot& slot = slots[(vma >> 2) & (slots.size() - 1)];
+    if (!slot.isFilled || slot.vma != vma) {
+      slot.result = getter(vma);
+      slot.vma = vma;
+      slot.isFilled = true;
+    }
+    return slot.result;
+  }
+
+  /// @brief Forgets all results, e.g. before scanning another section
+  void clear() {
+    for (Slot& slot : slots)
+      slot.isFilled = false;
+  }
+
+private:
+  struct Slot {
+    uint32_t vma = 0;
+    bool isFilled = false;
+    Result result{};
+  };
+
+  Getter getter;
+  mutable std::vector<Slot> slots;
+};
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+#include "ppcdisasm/ppc-dis.hpp"
+
+namespace aipg {
+/// @brief Lightweight result of a symbol getter: a relocation kind and a name that outlives the scan, e.g. in a symbol table.
+/// Unlike ppcdisasm::RelocationTarget, returning one neither allocates nor copies the name
+struct SymbolView {
+  int kind;
+  std::string_view name;
+};
+
+// The generated matchers accept any callable symbolGetter(uint32_t vma) whose result has symbolKind and symbolName overloads,
+// found in this namespace or by argument-dependent lookup
+constexpr int symbolKind(const SymbolView& target) { return target.kind; }
+constexpr std::string_view symbolName(const SymbolView& target) { return target.name; }
+inline int symbolKind(const ppcdisasm::RelocationTarget& target) { return target.kind; }
+inline std::string_view symbolName(const ppcdisasm::RelocationTarget& target) { return target.name; }
+
+/// @brief Type of the symbol getter used when none is given, a plain function pointer rather than a ppcdisasm::SymbolGetter
+using DefaultSymbolGetter = decltype(&ppcdisasm::defaultSymbolGetter);
+
+/// @brief Type returned by symbolGetter(vma)
+template< class Getter >
+using SymbolOf = std::decay_t<std::invoke_result_t<const Getter&, uint32_t>>;
+
+/// @brief Whether the names returned by Getter outlive the scan, so that labels can be captured as views of them.
+/// True of getters returning SymbolView, whose names must outlive the scan by contract
+template< class Getter >
+constexpr bool hasStableSymbolNames = std::is_same_v<SymbolOf<Getter>, SymbolView>;
+
+/// @brief Stores each distinct string once, at an address that stays valid until the pool is destroyed. Safe to use from several threads
+class StringPool {
+public:
+  std::string_view intern(std::string_view str) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = strings.find(str);
+    if (it == strings.end()) it = strings.emplace(str).first;
+    return *it;
+  }
+
+private:
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+  };
+
+  std::mutex mutex;
+  std::unordered_set<std::string, Hash, std::equal_to<>> strings;
+};
+
+/// @brief Symbol getter returning the results of another one as SymbolViews, with the names interned in a pool that lives as long as it does.
+/// The generated matchers wrap getters without stable names in one for the duration of a scan. The pool is only allocated once a name is interned
+template< class Getter >
+class InterningSymbolGetter {
+public:
+  explicit InterningSymbolGetter(Getter getter) : getter(std::move(getter)) {}
+  InterningSymbolGetter(InterningSymbolGetter&& other) : getter(std::move(other.getter)), pool(other.pool.exchange(nullptr)) {}
+  InterningSymbolGetter& operator=(InterningSymbolGetter&&) = delete;
+  ~InterningSymbolGetter() { delete pool.load(); }
+
+  SymbolView operator()(uint32_t vma) const {
+    const auto& target = getter(vma);
+    std::string_view name = symbolName(target);
+    return {symbolKind(target), name.empty() ? std::string_view() : stringPool().intern(name)};
+  }
+
+private:
+  StringPool& stringPool() const {
+    StringPool* current = pool.load(std::memory_order_acquire);
+    if (current != nullptr) return *current;
+    // several threads may get here at once, the first one to publish its pool wins
+    auto created = std::make_unique<StringPool>();
+    if (pool.compare_exchange_strong(current, created.get(), std::memory_order_acq_rel)) return *created.release();
+    return *current;
+  }
+
+  Getter getter;
+  mutable std::atomic<StringPool*> pool = nullptr;
+};
+
+/// @brief Getter itself if its names are stable or no labels are captured, otherwise Getter wrapped in an InterningSymbolGetter
+template< class Getter, bool CapturesLabels = true >
+using StableSymbolGetter = std::conditional_t<!CapturesLabels || hasStableSymbolNames<Getter>, Getter, InterningSymbolGetter<Getter>>;
+
+/// @brief Refers to symbolGetter as a StableSymbolGetter, for the duration of a scan
+template< bool CapturesLabels = true, class Getter >
+StableSymbolGetter<std::reference_wrapper<const Getter>, CapturesLabels> stableSymbolGetter(const Getter& symbolGetter) {
+  return StableSymbolGetter<std::reference_wrapper<const Getter>, CapturesLabels>(std::reference_wrapper<const Getter>(symbolGetter));
+}
+}
\ No newline at end of file
@@ -1,13 +1,18 @@
 
 //#include "aipg/aipg.hpp"
 
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <set>
 #include <sstream>
-#include <regex>
+#include <string_view>
 #include <vector>
 
 // ppcdisasm-cpp
 #include "opcode/ppc.h"
 #include "ppcdisasm/ppc-dis.hpp"
+#include "ppcdisasm/ppc-operands.h"
 #include "ppcdisasm/ppc-relocations.h"
 
 // inja
@@ -15,81 +20,138 @@
 
 #define STR(N) std::to_string(N)
 
-// consume any asm line
-#define CONSUME_ASM_PTRN "..."
-
-// insn mnemonic
-#define MNEMONIC_PTRN "[a-zA-Z][a-zA-Z0-9.+\\-]{0,20}"
-// insn operand
-#define OPERAND_PTRN "\\$?\\w+"
-
-// GPR variable
-#define VAR_GPR_PTRN "\\$GPR(\\d*)"
-// wildcard (any) GPR
-#define WLD_GPR_PTRN "\\$GPR\\?"
-// defined GPR
-#define DEF_GPR_PTRN "r(\\d\\d?)"
-
-// FPR variable
-#define VAR_FPR_PTRN "\\$FPR(\\d*)"
-// wildcard (any) FPR
-#define WLD_FPR_PTRN "\\$FPR\\?"
-// defined FPR
-#define DEF_FPR_PTRN "f(\\d\\d?)"
-#define FPR_PTRN "(?:" VAR_FPR_PTRN "|" DEF_FPR_PTRN ")"
-
-#define HEX_NATURALNUM_LITERAL_PTRN "0[xX][0-9a-fA-F]+"
-#define DEC_NATURALNUM_LITERAL_PTRN "\\d+"
-// defined immediate
-#define DEF_IMM_PTRN "-?(?:" HEX_NATURALNUM_LITERAL_PTRN "|" DEC_NATURALNUM_LITERAL_PTRN ")"
-// immediate variable
-#define VAR_IMM_PTRN "\\$IMM(\\d*)"
-// wildcard (any) immediate
-#define WLD_IMM_PTRN "\\$IMM\\?"
-
-// TODO: figure out how to support relocs to support label/reloc idiom parsing (match target address vs match label string)
-#if 1
-// label (aka valid C identifier)
-#define DEF_LABEL_PTRN "[_a-zA-Z][_a-zA-Z0-9]{0,30}"
-#define VAR_LABEL_PTRN "\\$LAB(\\d*)"
-#define WLD_LABEL_PTRN "\\$LAB\\?"
-#endif
+#define GAP_UNBOUNDED UINT32_MAX
 
 #define RELOC_ADDR16_LO 4
 #define RELOC_ADDR16_HI 5
 #define RELOC_ADDR16_HA 6
 #define RELOC_EMB_SDA21 109
 
-// register specifiers
-#define READ_SPEC_LIST_PTRN "\\^?\\{([\\$\\w,\\s]+)\\}"
-#define WRITE_SPEC_LIST_PTRN "\\^?\\[([\\$\\w,\\s]+)\\]"
-
-const std::regex EMPTY_RE("\\s");
-const std::regex CONSUME_ASM_RE(CONSUME_ASM_PTRN);
-const std::regex MNEMONIC_RE(MNEMONIC_PTRN);
-const std::regex OPERAND_RE(OPERAND_PTRN);
-const std::regex VAR_GPR_RE(VAR_GPR_PTRN);
-const std::regex WLD_GPR_RE(WLD_GPR_PTRN);
-const std::regex DEF_GPR_RE(DEF_GPR_PTRN);
-const std::regex VAR_FPR_RE(VAR_FPR_PTRN);
-const std::regex WLD_FPR_RE(WLD_FPR_PTRN);
-const std::regex DEF_FPR_RE(DEF_FPR_PTRN);
-const std::regex VAR_IMM_RE(VAR_IMM_PTRN);
-const std::regex WLD_IMM_RE(WLD_IMM_PTRN);
-const std::regex DEF_IMM_RE(DEF_IMM_PTRN);
-const std::regex VAR_LAB_RE(VAR_LABEL_PTRN);
-const std::regex WLD_LAB_RE(WLD_LABEL_PTRN);
-const std::regex DEF_LAB_RE(DEF_LABEL_PTRN);
-const std::regex READ_SPEC_LIST_RE(READ_SPEC_LIST_PTRN);
-const std::regex WRITE_SPEC_LIST_RE(WRITE_SPEC_LIST_PTRN);
+// Hand-written lexer for the idiom grammar. Each lex function matches exactly the text its pattern describes, std::regex
+// used to take most of the generation time
+
+// the characters of \w, \d and \s, independent of the locale
+bool isWordChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+bool isDigitChar(char c) { return c >= '0' && c <= '9'; }
+bool isSpaceChar(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; }
+
+bool isAllDigits(std::string_view str) { return std::all_of(str.begin(), str.end(), isDigitChar); }
+
+size_t skipWhile(std::string_view str, size_t pos, bool (*pred)(char)) {
+  while (pos < str.size() && pred(str[pos])) pos++;
+  return pos;
+}
+
+// [pos, pos+len) of a lexed string
+struct Token {
+  size_t pos;
+  size_t len;
+};
+
+// insn mnemonic at the start of str: [a-zA-Z][a-zA-Z0-9.+\-]{0,20}
+std::optional<Token> lexMnemonic(std::string_view str) {
+  auto isMnemonicChar = [](char c) { return (isWordChar(c) && c != '_') || c == '.' || c == '+' || c == '-'; };
+  if (str.empty() || !((str[0] >= 'a' && str[0] <= 'z') || (str[0] >= 'A' && str[0] <= 'Z'))) return std::nullopt;
+  size_t len = 1;
+  while (len < str.size() && len < 21 && isMnemonicChar(str[len])) len++;
+  return Token{0, len};
+}
+
+// next insn operand or constraint in str: \$?\w+
+std::optional<Token> lexOperand(std::string_view str) {
+  for (size_t start = 0; start < str.size(); start++) {
+    size_t wordStart = str[start] == '$' ? start + 1 : start;
+    size_t wordEnd = skipWhile(str, wordStart, isWordChar);
+    if (wordEnd > wordStart) return Token{start, wordEnd - start};
+  }
+  return std::nullopt;
+}
+
+// variable of the kind named by prefix, e.g. \$GPR(\d*), returns its (possibly empty) index
+std::optional<std::string_view> lexVariable(std::string_view str, std::string_view prefix) {
+  if (str.substr(0, prefix.size()) != prefix || !isAllDigits(str.substr(prefix.size()))) return std::nullopt;
+  return str.substr(prefix.size());
+}
+
+// wildcard of the kind named by prefix, e.g. \$GPR\?
+bool lexWildcard(std::string_view str, std::string_view prefix) {
+  return str.size() == prefix.size() + 1 && str.substr(0, prefix.size()) == prefix && str.back() == '?';
+}
+
+// defined register, r(\d\d?) or f(\d\d?), returns its number
+std::optional<std::string_view> lexRegister(std::string_view str, char letter) {
+  if (str.size() < 2 || str.size() > 3 || str[0] != letter || !isAllDigits(str.substr(1))) return std::nullopt;
+  return str.substr(1);
+}
+
+// label, aka valid C identifier: [_a-zA-Z][_a-zA-Z0-9]{0,30}
+// TODO: figure out how to support relocs to support label/reloc idiom parsing (match target address vs match label string)
+bool lexLabel(std::string_view str) {
+  if (str.empty() || str.size() > 31 || isDigitChar(str[0])) return false;
+  return std::all_of(str.begin(), str.end(), isWordChar);
+}
+
+// defined immediate: -?(?:0[xX][0-9a-fA-F]+|\d+)
+bool lexImmediate(std::string_view str) {
+  if (!str.empty() && str[0] == '-') str.remove_prefix(1);
+  if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+    return std::all_of(str.begin() + 2, str.end(), [](char c) { return std::isxdigit((unsigned char) c) != 0; });
+  return !str.empty() && isAllDigits(str);
+}
+
+// bounds on the number of instructions consumed by ..., e.g. {0,16}: \{\s*(\d+)\s*(,\s*(\d*)\s*)?\}
+struct GapBounds {
+  std::string_view min;
+  bool hasMax;
+  std::string_view max; // empty if unbounded
+  size_t len;
+};
+
+// bounds at the start of str
+std::optional<GapBounds> lexGapBounds(std::string_view str) {
+  GapBounds bounds{{}, false, {}, 0};
+  if (str.empty() || str[0] != '{') return std::nullopt;
+  size_t pos = skipWhile(str, 1, isSpaceChar);
+  size_t minEnd = skipWhile(str, pos, isDigitChar);
+  if (minEnd == pos) return std::nullopt;
+  bounds.min = str.substr(pos, minEnd - pos);
+  pos = skipWhile(str, minEnd, isSpaceChar);
+  if (pos < str.size() && str[pos] == ',') {
+    bounds.hasMax = true;
+    pos = skipWhile(str, pos + 1, isSpaceChar);
+    size_t maxEnd = skipWhile(str, pos, isDigitChar);
+    bounds.max = str.substr(pos, maxEnd - pos);
+    pos = skipWhile(str, maxEnd, isSpaceChar);
+  }
+  if (pos >= str.size() || str[pos] != '}') return std::nullopt;
+  bounds.len = pos + 1;
+  return bounds;
+}
+
+// next register specifier list in str, delimited by open and close:
+// reads \^?\{([\$\w,\s]+)\}, writes \^?\[([\$\w,\s]+)\]
+std::optional<Token> lexConstraintList(std::string_view str, char open, char close) {
+  auto isListChar = [](char c) { return isWordChar(c) || isSpaceChar(c) || c == '$' || c == ','; };
+  for (size_t start = 0; start < str.size(); start++) {
+    size_t pos = str[start] == '^' ? start + 1 : start;
+    if (pos >= str.size() || str[pos] != open) continue;
+    size_t end = pos + 1;
+    while (end < str.size() && isListChar(str[end])) end++;
+    if (end > pos + 1 && end < str.size() && str[end] == close) return Token{start, end + 1 - start};
+  }
+  return std::nullopt;
+}
 
 inja::Environment injaEnv {TEMPLATES_DIR};
 const inja::Template sourceTemplate = injaEnv.parse_template("/source.j2");
 const inja::Template includeTemplate = injaEnv.parse_template("/header.j2");
-const inja::Template insCheckSingleTemplate = injaEnv.parse_template("/insCheckSingle.j2");
+const inja::Template combinedTemplate = injaEnv.parse_template("/combined.j2");
+const inja::Template registerUseTableTemplate = injaEnv.parse_template("/registerUseTable.j2");
+const inja::Template tableTemplate = injaEnv.parse_template("/table.j2");
 const inja::Template insCheckLoopTemplate = injaEnv.parse_template("/insCheckLoop.j2");
 const inja::Template isInsMatchingTemplate = injaEnv.parse_template("/isInsnMatching.j2");
-const inja::Template isMnemonicMatchingTemplate = injaEnv.parse_template("/isMnemonicMatching.j2");
 const inja::Template hasOperandOptionalValueTemplate = injaEnv.parse_template("/hasOperandOptionalValue.j2");
 const inja::Template isVariableGprMatchingTemplate = injaEnv.parse_template("/isVariableGprMatching.j2");
 const inja::Template isDefinedGprMatchingTemplate = injaEnv.parse_template("/isDefinedGprMatching.j2");
@@ -102,6 +164,12 @@ const inja::Template isDefinedLabMatchingTemplate = injaEnv.parse_template("/isD
 
 using json = nlohmann::json;
 
+std::string hexString(uint64_t value) {
+  std::ostringstream oss;
+  oss << "0x" << std::hex << value;
+  return oss.str();
+}
+
 struct powerpc_opcode* lookup_mnemonic(const std::string& mnemonic) {
   for (struct powerpc_opcode* op = (struct powerpc_opcode*) powerpc_opcodes; op < powerpc_opcodes + powerpc_num_opcodes; op++) {
     if (mnemonic == op->name)
@@ -111,20 +179,19 @@ struct powerpc_opcode* lookup_mnemonic(const std::string& mnemonic) {
 }
 
 void parseRelocIfExists(json& operand_json, const std::string& suffix) {
-    std::smatch reloc_match;
     if (suffix[0] == '@') {
       std::string reloc_name = suffix.substr(1);
-      if (std::regex_match(reloc_name, reloc_match, DEF_LAB_RE)) {
-        if (reloc_match[0] == "ha") {
+      if (lexLabel(reloc_name)) {
+        if (reloc_name == "ha") {
           operand_json["relocKind"] = R_PPC_ADDR16_HA;
-        } else if (reloc_match[0] == "h") {
+        } else if (reloc_name == "h") {
           operand_json["relocKind"] = R_PPC_ADDR16_HI;
-        } else if (reloc_match[0] == "l") {
+        } else if (reloc_name == "l") {
           operand_json["relocKind"] = R_PPC_ADDR16_LO;
-        } else if (reloc_match[0] == "sda21") {
+        } else if (reloc_name == "sda21") {
           operand_json["relocKind"] = R_PPC_EMB_SDA21;
         } else {
-          std::cout << "Unknown reloc specifier " << reloc_match[0] << std::endl;
+          std::cout << "Unknown reloc specifier " << reloc_name << std::endl;
           exit(-1);
         }
       } else {
@@ -134,6 +201,115 @@ void parseRelocIfExists(json& operand_json, const std::string& suffix) {
     }
 }
 
+// Folds a defined operand into the fixed bits of its line, if the operand is a plain bitfield without a custom extract function.
+// Mirrors operand_value_powerpc, returns false if the value has to be checked at runtime instead
+bool foldDefinedOperand(const struct powerpc_operand* operand, int64_t operand_val, uint64_t& mask, uint64_t& value) {
+  if (operand->extract != nullptr || operand->shift < 0) return false;
+  uint64_t field = (uint64_t) operand_val & operand->bitm;
+  int64_t extracted = field;
+  if ((operand->flags & PPC_OPERAND_SIGNED) != 0) {
+    uint64_t top = operand->bitm;
+    top |= (top & -top) - 1;
+    top &= ~(top >> 1);
+    extracted = (field ^ top) - top;
+  }
+  if (extracted != operand_val) return false; // not representable, let the runtime check reject it
+  mask |= operand->bitm << operand->shift;
+  value |= field << operand->shift;
+  return true;
+}
+
+// Value extracted from a defined operand written as literal, if the operand's field can hold it. The range is the assembler's: signed
+// fields take values of their width, SIGNOPT ones also the unsigned values and NEGATIVE ones the negated range, and a literal
+// sign-extended by hand up to 32 bits is sign-extended to 64. Operands with a custom extract function are left to the runtime check
+std::optional<int64_t> operandFieldValue(const struct powerpc_operand* operand, int64_t literal) {
+  if (operand->extract != nullptr) return literal;
+  int64_t max = operand->bitm;
+  int64_t right = max & -max;
+  int64_t min = 0;
+  if ((operand->flags & PPC_OPERAND_SIGNOPT) != 0) {
+    min = ~(max >> 1) & -right;
+  } else if ((operand->flags & PPC_OPERAND_SIGNED) != 0) {
+    max = (max >> 1) & -right;
+    min = ~max & -right;
+  }
+  if ((operand->flags & PPC_OPERAND_NEGATIVE) != 0) {
+    int64_t tmp = min;
+    min = -max;
+    max = -tmp;
+  }
+  if (literal > max && (literal & ~INT64_C(0xffffffff)) == 0 && (literal & 0x80000000) != 0)
+    literal = static_cast<int32_t>(literal);
+  if (literal < min || literal > max || (literal & (right - 1)) != 0) return std::nullopt;
+  // a SIGNOPT field reads back as signed or unsigned as its SIGNED flag says, e.g. lis r3,0x8889 reads as -0x7777
+  if ((operand->flags & PPC_OPERAND_SIGNOPT) != 0) {
+    bool isSigned = (operand->flags & PPC_OPERAND_SIGNED) != 0;
+    if (isSigned && literal > ((int64_t) operand->bitm >> 1)) literal -= operand->bitm + right;
+    if (!isSigned && literal < 0) literal += operand->bitm + right;
+  }
+  return literal;
+}
+
+// Expression extracting the value of operand from insn, mirroring operand_value_powerpc with the operand's fields known at generation time.
+// Empty if the operand has a custom extract function, whose value is left to operand_value_powerpc at runtime
+std::string extractExpression(const struct powerpc_operand* operand) {
+  if (operand->extract != nullptr) return "";
+  std::string field = operand->shift >= 0 ? "((insn >> " + STR(operand->shift) + ") & " + hexString(operand->bitm) + ")"
+                                          : "((insn << " + STR(-operand->shift) + ") & " + hexString(operand->bitm) + ")";
+  if ((operand->flags & PPC_OPERAND_SIGNED) == 0) return "static_cast<int64_t>" + field;
+  uint64_t top = operand->bitm;
+  top |= (top & -top) - 1;
+  top &= ~(top >> 1);
+  return "static_cast<int64_t>(" + field + " ^ " + hexString(top) + ") - static_cast<int64_t>(" + hexString(top) + ")";
+}
+
+// Describes how to extract the value of operand from an instruction to the table backend, the same way as extractExpression
+void addExtractFields(json& operand_data, const struct powerpc_operand* operand) {
+  operand_data["usesExtractFn"] = operand->extract != nullptr;
+  operand_data["shift"] = operand->shift;
+  operand_data["bitm"] = hexString(operand->bitm);
+  uint64_t top = 0;
+  if ((operand->flags & PPC_OPERAND_SIGNED) != 0) {
+    top = operand->bitm;
+    top |= (top & -top) - 1;
+    top &= ~(top >> 1);
+  }
+  operand_data["signBit"] = hexString(top);
+}
+
+// Same test as lookup_powerpc, for checking idioms against the dialect given with --dialect
+bool isOpcodeInDialect(const struct powerpc_opcode* opcode, ppc_cpu_t dialect) {
+  return !(((dialect & PPC_OPCODE_ANY) == 0 && ((opcode->flags & dialect) == 0 || (opcode->deprecated & dialect) != 0))
+           || (opcode->deprecated & dialect & PPC_OPCODE_RAW) != 0);
+}
+
+// Parses a comma separated list of dialect names (or numeric PPC_OPCODE_* flags) as given to --dialect, e.g. ppc,750
+ppc_cpu_t parseDialect(const std::string& dialectList) {
+  static const std::map<std::string, ppc_cpu_t> DIALECT_NAMES = {
+    {"ppc", PPC_OPCODE_PPC}, {"power", PPC_OPCODE_POWER}, {"750", PPC_OPCODE_750}, {"common", PPC_OPCODE_COMMON},
+    {"any", PPC_OPCODE_ANY}, {"raw", PPC_OPCODE_RAW}, {"64", PPC_OPCODE_64}, {"altivec", PPC_OPCODE_ALTIVEC},
+  };
+  ppc_cpu_t dialect = 0;
+  std::istringstream names(dialectList);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    auto it = DIALECT_NAMES.find(name);
+    if (it != DIALECT_NAMES.end()) {
+      dialect |= it->second;
+      continue;
+    }
+    try {
+      size_t parsedLen;
+      dialect |= std::stoull(name, &parsedLen, 0);
+      if (parsedLen != name.size()) throw std::invalid_argument(name);
+    } catch (const std::logic_error&) {
+      std::cerr << "Unknown dialect " << name << std::endl;
+      exit(-1);
+    }
+  }
+  return dialect;
+}
+
 // I wholeheartedly trust this excerpt from gas' gas/tc-ppc.c for detecting if optional operands are skipped
 // https://chromium.googlesource.com/chromiumos/third_party/binutils/+/refs/heads/firmware-samus-6300.B/gas/config/tc-ppc.c#2663
 bool skip_optional(char* line, const powerpc_opcode* opcode) {
@@ -175,7 +351,85 @@ bool skip_optional(char* line, const powerpc_opcode* opcode) {
 }
 
 namespace aipg {
-std::tuple<std::string, std::string> generateParser(const std::string& idiom, const std::string& idiom_name) {
+// How the generated matchers check the idiom's lines
+enum class Backend {
+  // straight-line code for each line and operand
+  Code,
+  // a constexpr table of the lines and operands, run by the shared interpreter of aipg/interpreter.hpp
+  Table,
+};
+
+// Flattens the lines of the idiom into the tables of aipg::IdiomTable, see table.j2
+json generateTableData(const json& ins_datas, const std::string& idiom_name) {
+  static const std::map<std::string, std::string> REGISTER_USE_KINDS = {
+    {"gprReads", "REGISTER_USE_GPR_READS"}, {"gprWrites", "REGISTER_USE_GPR_WRITES"},
+    {"fprReads", "REGISTER_USE_FPR_READS"}, {"fprWrites", "REGISTER_USE_FPR_WRITES"},
+  };
+  static const std::map<std::string, uint32_t> REGISTER_USE_BITS = {{"gprReads", 1}, {"gprWrites", 2}, {"fprReads", 4}, {"fprWrites", 8}};
+
+  json table_data;
+  table_data["idiom_name"] = idiom_name;
+  table_data["lines"] = json::array();
+  table_data["operands"] = json::array();
+  table_data["registers"] = json::array();
+  for (const json& ins_data : ins_datas) {
+    json line;
+    line["mask"] = ins_data["mask"];
+    line["value"] = ins_data["value"];
+    line["opcodeFlags"] = ins_data["opcodeFlags"];
+    line["opcodeDeprecated"] = ins_data["opcodeDeprecated"];
+    line["firstOperand"] = table_data["operands"].size();
+    for (const json& operand_data : ins_data["operands"]) {
+      std::string action = operand_data["action"];
+      bool isBind = action.rfind("Bind", 0) == 0;
+      json entry;
+      entry["action"] = action;
+      entry["var"] = 0;
+      entry["value"] = 0;
+      for (const char* key : {"gpr", "fpr", "imm", "lab"}) {
+        if (operand_data.contains(key)) entry[isBind ? "var" : "value"] = operand_data[key];
+      }
+      if (action == "OptionalValue") entry["value"] = operand_data["num_optional"];
+      entry["usesExtractFn"] = operand_data["usesExtractFn"];
+      entry["shift"] = operand_data["shift"];
+      entry["bitm"] = operand_data["bitm"];
+      entry["signBit"] = operand_data["signBit"];
+      entry["operandIdx"] = operand_data["idx"];
+      entry["relocKind"] = operand_data.value("relocKind", -1);
+      entry["label"] = operand_data.contains("label") ? "\"" + operand_data["label"].get<std::string>() + "\"" : "nullptr";
+      table_data["operands"].push_back(entry);
+    }
+    line["numOperands"] = table_data["operands"].size() - line["firstOperand"].get<size_t>();
+
+    line["isGap"] = ins_data["isGap"];
+    line["gapStopsAtFunctionEnd"] = ins_data.value("gapStopsAtFunctionEnd", false);
+    line["gapMin"] = ins_data.value("gapMin", json(0));
+    line["gapMax"] = ins_data.value("gapMax", json(0));
+    line["firstRegister"] = table_data["registers"].size();
+    uint32_t hasAllowed = 0;
+    for (const json& check : ins_data.value("registerChecks", json::array())) {
+      std::string use = check["use"];
+      if (check["hasAllowed"]) hasAllowed |= REGISTER_USE_BITS.at(use);
+      for (const json& reg : check["constraints"]) {
+        json entry;
+        entry["use"] = REGISTER_USE_KINDS.at(use);
+        entry["isFpr"] = check["kind"] == "fpr";
+        entry["isVariable"] = reg["isVariable"];
+        entry["isNotAllowed"] = reg["isNotAllowed"];
+        entry["val"] = reg["val"];
+        table_data["registers"].push_back(entry);
+      }
+    }
+    line["numRegisters"] = table_data["registers"].size() - line["firstRegister"].get<size_t>();
+    line["hasAllowed"] = hasAllowed;
+    table_data["lines"].push_back(line);
+  }
+  return table_data;
+}
+
+// Returns the generated header, which holds all of the idiom's code, and a description of the idiom's anchor (first line) used by combined scanners
+// If bakedDialect is given, every mnemonic must be available in it and it becomes the default of the overloads taking the dialect as template argument
+std::tuple<std::string, json> generateParser(const std::string& idiom, const std::string& idiom_name, std::optional<ppc_cpu_t> bakedDialect, Backend backend) {
   // read idiom line by line
   std::istringstream iss(idiom);
   std::string line;
@@ -188,20 +442,50 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
   json include_data;
   include_data["idiom_name"] = idiom_name;
   std::vector<std::string> definitions;
-  definitions.push_back(injaEnv.render(isMnemonicMatchingTemplate, source_data));
-  std::vector<std::string> parserChecks;
+  // the checks of the lines and operands as code, only the default backend emits them
+  auto addDefinition = [&](const inja::Template& definitionTemplate, const json& data) {
+    if (backend == Backend::Code) definitions.push_back(injaEnv.render(definitionTemplate, data));
+  };
 
   // flag for ... expression to generate runtime that repeatedly checks for pattern
   bool checkNextRepeated = false;
+  // minimum and maximum number of instructions the ... lines before the next asm line may consume
+  uint32_t gapMin = 0;
+  uint32_t gapMax = 0;
+  // ...! lines do not consume instructions past the end of the function
+  bool gapStopsAtFunctionEnd = false;
   json ins_constraints;
   auto clear_ins_constraints = [&ins_constraints]() {
     ins_constraints["gprWriteConstraints"] = json::array();
     ins_constraints["gprReadConstraints"] = json::array();
     ins_constraints["fprWriteConstraints"] = json::array();
     ins_constraints["fprReadConstraints"] = json::array();
+    // whether the lists above contain registers that are allowed (as opposed to only ^ registers that are not allowed)
+    ins_constraints["hasGprWriteAllowed"] = false;
+    ins_constraints["hasGprReadAllowed"] = false;
+    ins_constraints["hasFprWriteAllowed"] = false;
+    ins_constraints["hasFprReadAllowed"] = false;
   };
   clear_ins_constraints();
 
+  // one past the highest index of each kind of variable, to size the idiom's context
+  uint32_t numGprs = 0;
+  uint32_t numFprs = 0;
+  uint32_t numImms = 0;
+  uint32_t numLabs = 0;
+  auto useVariable = [&lineNum](uint32_t& numVariables, uint32_t varIdx) {
+    if (varIdx >= 64) {
+      std::cerr << "Variable index " << varIdx << " at line " << lineNum << " is too large, indexes must be less than 64" << std::endl;
+      exit(-1);
+    }
+    numVariables = std::max(numVariables, varIdx + 1);
+  };
+  // variables bound by the idiom's lines (as opposed to only appearing in constraints), each gets a field in the idiom's captures
+  std::set<uint32_t> capturedGprs;
+  std::set<uint32_t> capturedFprs;
+  std::set<uint32_t> capturedImms;
+  std::set<uint32_t> capturedLabs;
+
   bool isInMultiLineComment = false;
   while (std::getline(iss, line)) {
     lineNum++;
@@ -225,13 +509,11 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
     }
     if (std::all_of(line.begin(),line.end(),isspace)) continue; // ignore empty lines
 
-    std::smatch mnemonic_match;
-    std::smatch dummy_match;
-    std::string tmp; // hack because match does not work with temp strings
+    size_t gapIdx;
     // mnemonic at the start of line ?
-    if (std::regex_search(line, mnemonic_match, MNEMONIC_RE) && mnemonic_match.prefix().str() == "") {
+    if (std::optional<Token> mnemonic_token = lexMnemonic(line)) {
       // -------- Assembly line --------
-      std::string mnemonic = mnemonic_match[0];
+      std::string mnemonic = line.substr(0, mnemonic_token->len);
       struct powerpc_opcode* opcode = lookup_mnemonic(mnemonic);
       if (opcode == nullptr) {
         std::cerr << "Unknown mnemonic" << mnemonic << " at line " << lineNum << std::endl;
@@ -243,8 +525,17 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
       ins_data["idiom_name"] = idiom_name;
       ins_data["operands"] = json::array();
       ins_data["opindex"] = opcode - powerpc_opcodes;
+      ins_data["opcodeFlags"] = hexString(opcode->flags);
+      ins_data["opcodeDeprecated"] = hexString(opcode->deprecated);
+      if (bakedDialect && !isOpcodeInDialect(opcode, *bakedDialect)) {
+        std::cerr << "Mnemonic " << mnemonic << " at line " << lineNum << " is not available in dialect " << hexString(*bakedDialect) << std::endl;
+        exit(-1);
+      }
+      // bits of the instruction word fixed by the mnemonic and the defined operands
+      uint64_t lineMask = opcode->mask;
+      uint64_t lineValue = opcode->opcode;
 
-      std::string operands = mnemonic_match.suffix();
+      std::string operands = line.substr(mnemonic_token->len);
       bool skips_optional_operands = skip_optional(const_cast<char*>(line.c_str()), opcode);
       int num_optional = 0; // (negative) number of optional arguments in this instruction (needed for checking optional operands)
 
@@ -255,59 +546,72 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
         operand = powerpc_operands + *opindex;
         json operand_data;
         operand_data["idx"] = *opindex;
+        std::string extract = extractExpression(operand);
+        if (!extract.empty()) operand_data["extract"] = extract;
+        addExtractFields(operand_data, operand);
         json opData; // container of operand_data for operand matching templates
         opData["lineNo"] = lineNum;
         opData["idiom_name"] = idiom_name;
 
         // match next operand (word) (maybe check if the asm is properly formatted and not just go to next operand?)
-        std::smatch operand_match;
         std::string operand_string;
         if ((operand->flags & PPC_OPERAND_OPTIONAL) != 0 && skips_optional_operands) { // TODO: Support OPERAND_NEXT for 5 arg rotate-mask instructions
           num_optional--;
           operand_data["isSkippedOptional"] = true;
           operand_data["num_optional"] = num_optional;
+          operand_data["action"] = "OptionalValue";
           opData["operand"] = operand_data;
-          definitions.push_back(injaEnv.render(hasOperandOptionalValueTemplate, opData));
+          addDefinition(hasOperandOptionalValueTemplate, opData);
           ins_data["operands"].push_back(operand_data);
           continue;
-        } else if (std::regex_search(operands, operand_match, OPERAND_RE)) {
-          operand_string = operand_match[0];
-          operands = operand_match.suffix();
+        } else if (std::optional<Token> operand_token = lexOperand(operands)) {
+          operand_string = operands.substr(operand_token->pos, operand_token->len);
+          operands = operands.substr(operand_token->pos + operand_token->len);
           operand_data["isSkippedOptional"] = false;
         } else {
           std::cerr << "Expected more operands at line " << lineNum << std::endl;
           exit(-1);
         }
 
-        std::smatch operand_type_match;
+        std::optional<std::string_view> operand_index;
         if ((operand->flags & PPC_OPERAND_GPR) != 0 ||
              (operand->flags & PPC_OPERAND_GPR_0) != 0) {
           // GPR
-          if (std::regex_match(operand_string, operand_type_match, VAR_GPR_RE)) {
+          if ((operand_index = lexVariable(operand_string, "$GPR"))) {
             try {
-              uint32_t gpr = std::stoi(operand_type_match[1]);
+              uint32_t gpr = std::stoi(std::string(*operand_index));
               operand_data["gpr"] = gpr;
-            } catch (std::invalid_argument iae) {
+              operand_data["action"] = "BindGpr";
+              useVariable(numGprs, gpr);
+              capturedGprs.insert(gpr);
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid GPR variable expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isVariableGprMatchingTemplate, opData));
+            addDefinition(isVariableGprMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
-          } else if (std::regex_match(operand_string, operand_type_match, WLD_GPR_RE)) {
+          } else if (lexWildcard(operand_string, "$GPR")) {
             // no runtime check is added
-          } else if (std::regex_match(operand_string, operand_type_match, DEF_GPR_RE)) {
+          } else if ((operand_index = lexRegister(operand_string, 'r'))) {
             try {
-              uint32_t gpr = std::stoi(operand_type_match[1]);
+              uint32_t gpr = std::stoi(std::string(*operand_index));
               operand_data["gpr"] = gpr;
-            } catch (std::invalid_argument iae) {
+              operand_data["action"] = "CompareValue";
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid defined GPR expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
+            if (!operandFieldValue(operand, operand_data["gpr"].get<int64_t>())) {
+              std::cerr << "Defined GPR out of the operand's range at line " << lineNum << ", " << operand_string << std::endl;
+              exit(-1);
+            }
+            // checked along with the mnemonic by a single mask compare, unless it needs the runtime extraction
+            if (foldDefinedOperand(operand, operand_data["gpr"].get<int64_t>(), lineMask, lineValue)) continue;
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isDefinedGprMatchingTemplate, opData));
+            addDefinition(isDefinedGprMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
           } else {
             std::cerr << "Expected mandatory GPR expression at line " << lineNum << ", got " << operand_string << " instead" << std::endl;
@@ -315,31 +619,41 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
           }
         } else if ((operand->flags & PPC_OPERAND_FPR) != 0) {
           // FPR
-          if (std::regex_match(operand_string, operand_type_match, VAR_FPR_RE)) {
+          if ((operand_index = lexVariable(operand_string, "$FPR"))) {
             try {
-              uint32_t fpr = std::stoi(operand_type_match[1]);
+              uint32_t fpr = std::stoi(std::string(*operand_index));
               operand_data["fpr"] = fpr;
-            } catch (std::invalid_argument iae) {
+              operand_data["action"] = "BindFpr";
+              useVariable(numFprs, fpr);
+              capturedFprs.insert(fpr);
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid FPR variable expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isVariableFprMatchingTemplate, opData));
+            addDefinition(isVariableFprMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
-          } else if (std::regex_match(operand_string, operand_type_match, WLD_FPR_RE)) {
+          } else if (lexWildcard(operand_string, "$FPR")) {
             // no runtime check is added
-          } else if (std::regex_match(operand_string, operand_type_match, DEF_FPR_RE)) {
+          } else if ((operand_index = lexRegister(operand_string, 'f'))) {
             try {
-              uint32_t fpr = std::stoi(operand_type_match[1]);
+              uint32_t fpr = std::stoi(std::string(*operand_index));
               operand_data["fpr"] = fpr;
-            } catch (std::invalid_argument iae) {
+              operand_data["action"] = "CompareValue";
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid defined FPR expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
+            if (!operandFieldValue(operand, operand_data["fpr"].get<int64_t>())) {
+              std::cerr << "Defined FPR out of the operand's range at line " << lineNum << ", " << operand_string << std::endl;
+              exit(-1);
+            }
+            // checked along with the mnemonic by a single mask compare, unless it needs the runtime extraction
+            if (foldDefinedOperand(operand, operand_data["fpr"].get<int64_t>(), lineMask, lineValue)) continue;
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isDefinedFprMatchingTemplate, opData));
+            addDefinition(isDefinedFprMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
           } else {
             std::cerr << "Expected mandatory FPR expression at line " << lineNum << ", got " << operand_string << " instead" << std::endl;
@@ -347,59 +661,71 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
           }
         } else {
           // immediate or label/address (TODO)
-          if (std::regex_match(operand_string, operand_type_match, VAR_LAB_RE)) {
+          if ((operand_index = lexVariable(operand_string, "$LAB"))) {
             try {
-              uint32_t lab = std::stoi(operand_type_match[1]);
+              uint32_t lab = std::stoi(std::string(*operand_index));
               operand_data["lab"] = lab;
+              operand_data["action"] = "BindLab";
+              useVariable(numLabs, lab);
+              capturedLabs.insert(lab);
               parseRelocIfExists(operand_data, operands);
-            } catch (std::invalid_argument iae) {
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid label expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isVariableLabMatchingTemplate, opData));
+            addDefinition(isVariableLabMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
-          } else if (std::regex_match(operand_string, operand_type_match, WLD_LAB_RE)) {
+          } else if (lexWildcard(operand_string, "$LAB")) {
             // no runtime check is added
-          } else if (std::regex_match(operand_string, operand_type_match, DEF_LAB_RE)) {
-            try {
-              uint32_t lab = std::stoi(operand_type_match[1]);
-              operand_data["lab"] = lab;
-              parseRelocIfExists(operand_data, operands);
-            } catch (std::invalid_argument iae) {
-              std::cerr << "Invalid defined immediate expression at line " << lineNum << ", " << operand_string << std::endl;
-              exit(-1);
-            }
+          } else if (lexLabel(operand_string)) {
+            operand_data["label"] = operand_string;
+            operand_data["action"] = "CompareLabel";
+            parseRelocIfExists(operand_data, operands);
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isDefinedLabMatchingTemplate, opData));
+            addDefinition(isDefinedLabMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
-          } else if (std::regex_match(operand_string, operand_type_match, VAR_IMM_RE)) {
+          } else if ((operand_index = lexVariable(operand_string, "$IMM"))) {
             try {
-              uint32_t imm = std::stoi(operand_type_match[1]);
+              uint32_t imm = std::stoi(std::string(*operand_index));
               operand_data["imm"] = imm;
-            } catch (std::invalid_argument iae) {
+              operand_data["action"] = "BindImm";
+              useVariable(numImms, imm);
+              capturedImms.insert(imm);
+            } catch (const std::logic_error&) {
               std::cerr << "Invalid immediate variable expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
             }
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isVariableImmMatchingTemplate, opData));
+            addDefinition(isVariableImmMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
-          } else if (std::regex_match(operand_string, operand_type_match, WLD_IMM_RE)) {
+          } else if (lexWildcard(operand_string, "$IMM")) {
             // no runtime check is added
-          } else if (std::regex_match(operand_string, operand_type_match, DEF_IMM_RE)) {
+          } else if (lexImmediate(operand_string)) {
+            std::optional<int64_t> imm;
             try {
-              uint32_t imm = std::stoi(operand_type_match[1]);
-              operand_data["imm"] = imm;
-            } catch (std::invalid_argument iae) {
+              int base = operand_string.find_first_of("xX") != std::string::npos ? 16 : 10;
+              imm = operandFieldValue(operand, std::stoll(operand_string, nullptr, base));
+            } catch (const std::invalid_argument&) {
               std::cerr << "Invalid defined immediate expression at line " << lineNum << ", " << operand_string << std::endl;
               exit(-1);
+            } catch (const std::out_of_range&) {
+              // reported below, along with the values that fit in 64 bits but not in the operand's field
             }
+            if (!imm) {
+              std::cerr << "Defined immediate out of the operand's range at line " << lineNum << ", " << operand_string << std::endl;
+              exit(-1);
+            }
+            operand_data["imm"] = *imm;
+            operand_data["action"] = "CompareValue";
+            // checked along with the mnemonic by a single mask compare, unless it needs the runtime extraction
+            if (foldDefinedOperand(operand, *imm, lineMask, lineValue)) continue;
 
             opData["operand"] = operand_data;
-            definitions.push_back(injaEnv.render(isDefinedImmMatchingTemplate, opData));
+            addDefinition(isDefinedImmMatchingTemplate, opData);
             ins_data["operands"].push_back(operand_data);
           } else {
             std::cerr << "Expected mandatory immediate expression or label at line " << lineNum << ", got " << operand_string << " instead" << std::endl;
@@ -408,53 +734,104 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
         }
       } // end of operand matching loop
 
-      definitions.push_back(injaEnv.render(isInsMatchingTemplate, ins_data));
+      ins_data["mask"] = hexString(lineMask);
+      ins_data["value"] = hexString(lineValue);
+      addDefinition(isInsMatchingTemplate, ins_data);
 
+      // a preceding ... lets the thread waiting on this line skip instructions
+      ins_data["isGap"] = checkNextRepeated;
       if (checkNextRepeated) {
         ins_data["ins_constraints"] = ins_constraints;
-        ins_data["parseCheck"] = injaEnv.render(insCheckLoopTemplate, ins_data);
-      } else {
-        ins_data["parseCheck"] = injaEnv.render(insCheckSingleTemplate, ins_data);
+        // one check per kind of register access that is constrained, against the registers the skipped instruction accesses
+        ins_data["registerChecks"] = json::array();
+        auto addRegisterCheck = [&](const char* constraintsKey, const char* hasAllowedKey, const char* use, const char* kind) {
+          if (ins_constraints[constraintsKey].empty()) return;
+          json check;
+          check["use"] = use;
+          check["kind"] = kind;
+          check["constraints"] = ins_constraints[constraintsKey];
+          check["hasAllowed"] = ins_constraints[hasAllowedKey];
+          ins_data["registerChecks"].push_back(check);
+        };
+        addRegisterCheck("gprWriteConstraints", "hasGprWriteAllowed", "gprWrites", "gpr");
+        addRegisterCheck("gprReadConstraints", "hasGprReadAllowed", "gprReads", "gpr");
+        addRegisterCheck("fprWriteConstraints", "hasFprWriteAllowed", "fprWrites", "fpr");
+        addRegisterCheck("fprReadConstraints", "hasFprReadAllowed", "fprReads", "fpr");
+        ins_data["gapMin"] = gapMin;
+        ins_data["gapMax"] = gapMax == GAP_UNBOUNDED ? json("UINT32_MAX") : json(gapMax);
+        ins_data["gapStopsAtFunctionEnd"] = gapStopsAtFunctionEnd;
+        addDefinition(insCheckLoopTemplate, ins_data);
       }
       source_data["ins_data"].push_back(ins_data);
 
       checkNextRepeated = false;
+      gapMin = 0;
+      gapMax = 0;
+      gapStopsAtFunctionEnd = false;
       clear_ins_constraints();
-    } else if (std::regex_search(line, mnemonic_match, CONSUME_ASM_RE)) {
+    } else if ((gapIdx = line.find("...")) != std::string::npos) {
       // -------- Consume any asm line --------
       checkNextRepeated = true;
       
-      std::string restOfLine = mnemonic_match.suffix();
+      std::string restOfLine = line.substr(gapIdx + 3);
+      if (!restOfLine.empty() && restOfLine[0] == '!') {
+        gapStopsAtFunctionEnd = true;
+        restOfLine = restOfLine.substr(1);
+      }
+      // optional bounds, consecutive ... lines add up
+      if (std::optional<GapBounds> bounds = lexGapBounds(restOfLine)) {
+        uint32_t boundMin = std::stoul(std::string(bounds->min));
+        uint32_t boundMax = boundMin;
+        if (bounds->hasMax) {
+          boundMax = !bounds->max.empty() ? std::stoul(std::string(bounds->max)) : GAP_UNBOUNDED;
+        }
+        if (boundMax < boundMin) {
+          std::cerr << "Invalid ... bounds at line " << lineNum << ", maximum is less than minimum" << std::endl;
+          exit(-1);
+        }
+        restOfLine = restOfLine.substr(bounds->len);
+        gapMin += boundMin;
+        gapMax = (gapMax == GAP_UNBOUNDED || boundMax == GAP_UNBOUNDED) ? GAP_UNBOUNDED : gapMax + boundMax;
+      } else {
+        gapMax = GAP_UNBOUNDED;
+      }
+      // the matchers already try every start position, a leading ... would try them again for every instruction it may consume
+      if (gapMax == GAP_UNBOUNDED && source_data["ins_data"].empty()) {
+        std::cerr << "Unbounded ... at line " << lineNum << " before the first instruction, give it a maximum or remove it" << std::endl;
+        exit(-1);
+      }
       // record operand constraints
-      std::smatch constraints_match;
+      std::optional<Token> constraints_token;
       std::string constraints_string;
-      while (std::regex_search(restOfLine, constraints_match, READ_SPEC_LIST_RE) || std::regex_search(restOfLine, constraints_match, WRITE_SPEC_LIST_RE)) {
-        constraints_string = constraints_match[0];
+      while ((constraints_token = lexConstraintList(restOfLine, '{', '}')) || (constraints_token = lexConstraintList(restOfLine, '[', ']'))) {
+        constraints_string = restOfLine.substr(constraints_token->pos, constraints_token->len);
         bool isNegative = constraints_string[0] == '^';
         bool isRead = constraints_string.find('{') != std::string::npos;
-        restOfLine = constraints_match.suffix();
+        restOfLine = restOfLine.substr(constraints_token->pos + constraints_token->len);
 
-        std::smatch constraint_match;
-        while (std::regex_search(constraints_string, constraint_match, OPERAND_RE)) {
-          std::string constraint_string = constraint_match[0];
-          constraints_string = constraint_match.suffix();
+        while (std::optional<Token> constraint_token = lexOperand(constraints_string)) {
+          std::string constraint_string = constraints_string.substr(constraint_token->pos, constraint_token->len);
+          constraints_string = constraints_string.substr(constraint_token->pos + constraint_token->len);
+          std::optional<std::string_view> constraint_index;
           json constraint;
           constraint["isNotAllowed"] = isNegative;
           constraint["isRead"] = isRead;
-          if (std::regex_match(constraint_string, constraint_match, VAR_GPR_RE)) {
-            constraint["val"] = std::stoi(constraint_match[1]);
+          if ((constraint_index = lexVariable(constraint_string, "$GPR"))) {
+            constraint["val"] = std::stoi(std::string(*constraint_index));
             constraint["isVariable"] = true;
+            useVariable(numGprs, constraint["val"].get<uint32_t>());
             constraint["type"] = "gpr";
-          } else if (std::regex_match(constraint_string, constraint_match, DEF_GPR_RE)) {
-            constraint["val"] = std::stoi(constraint_match[1]);
+          } else if ((constraint_index = lexRegister(constraint_string, 'r'))) {
+            constraint["val"] = std::stoi(std::string(*constraint_index));
             constraint["isVariable"] = false;
             constraint["type"] = "gpr";
-          } else if (std::regex_match(constraint_string, constraint_match, VAR_FPR_RE)) {
-            constraint["val"] = std::stoi(constraint_match[1]);
+          } else if ((constraint_index = lexVariable(constraint_string, "$FPR"))) {
+            constraint["val"] = std::stoi(std::string(*constraint_index));
             constraint["isVariable"] = true;
+            useVariable(numFprs, constraint["val"].get<uint32_t>());
             constraint["type"] = "fpr";
-          } else if (std::regex_match(constraint_string, constraint_match, DEF_FPR_RE)) {
-            constraint["val"] = std::stoi(constraint_match[1]);
+          } else if ((constraint_index = lexRegister(constraint_string, 'f'))) {
+            constraint["val"] = std::stoi(std::string(*constraint_index));
             constraint["isVariable"] = false;
             constraint["type"] = "fpr";
           } else {
@@ -463,16 +840,20 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
           }
 
           if (isRead) {
-            if (constraint["type"] == "gpr")
+            if (constraint["type"] == "gpr") {
               ins_constraints["gprReadConstraints"].push_back(constraint);
-            else if (constraint["type"] == "fpr") {
+              if (!isNegative) ins_constraints["hasGprReadAllowed"] = true;
+            } else if (constraint["type"] == "fpr") {
               ins_constraints["fprReadConstraints"].push_back(constraint);
+              if (!isNegative) ins_constraints["hasFprReadAllowed"] = true;
             }
           } else {
-            if (constraint["type"] == "gpr")
+            if (constraint["type"] == "gpr") {
               ins_constraints["gprWriteConstraints"].push_back(constraint);
-            else if (constraint["type"] == "fpr") {
+              if (!isNegative) ins_constraints["hasGprWriteAllowed"] = true;
+            } else if (constraint["type"] == "fpr") {
               ins_constraints["fprWriteConstraints"].push_back(constraint);
+              if (!isNegative) ins_constraints["hasFprWriteAllowed"] = true;
             }
           }
         }
@@ -481,10 +862,276 @@ std::tuple<std::string, std::string> generateParser(const std::string& idiom, co
   }
 
   source_data["definitions"] = definitions;
+  if (bakedDialect) include_data["dialect"] = hexString(*bakedDialect);
+  include_data["numGprs"] = numGprs;
+  include_data["numFprs"] = numFprs;
+  include_data["numImms"] = numImms;
+  include_data["numLabs"] = numLabs;
+  include_data["numLines"] = source_data["ins_data"].size();
+  include_data["captures"] = json::array();
+  auto addCaptures = [&include_data](const std::set<uint32_t>& captured, const std::string& kind, const std::string& type) {
+    for (uint32_t varIdx : captured) {
+      json capture;
+      capture["kind"] = kind;
+      capture["idx"] = varIdx;
+      capture["type"] = type;
+      include_data["captures"].push_back(capture);
+    }
+  };
+  addCaptures(capturedGprs, "gpr", "uint8_t");
+  addCaptures(capturedFprs, "fpr", "uint8_t");
+  addCaptures(capturedImms, "imm", "int32_t");
+  addCaptures(capturedLabs, "lab", "std::string");
+  source_data["captures"] = include_data["captures"];
+  source_data["numLabs"] = numLabs;
+  // most instructions a match can span, unless a ... is unbounded
+  std::optional<uint64_t> maxMatchLength = 0;
+  for (const json& ins_data : source_data["ins_data"]) {
+    if (ins_data["isGap"] && !ins_data["gapMax"].is_number()) maxMatchLength = std::nullopt;
+    if (!maxMatchLength) break;
+    *maxMatchLength += 1 + (ins_data["isGap"] ? ins_data["gapMax"].get<uint64_t>() : 0);
+  }
+  if (maxMatchLength && *maxMatchLength >= UINT32_MAX) maxMatchLength = std::nullopt;
+  source_data["maxMatchLength"] = maxMatchLength ? json(*maxMatchLength) : json("UINT32_MAX");
+  source_data["isMatchLengthBounded"] = maxMatchLength.has_value();
+  // fixed bits of the first line, used to prefilter candidate start positions. A leading ... (which is bounded) may consume the
+  // instruction at the start position, so no bits are fixed then and every position is a candidate
+  bool isAnchored = !source_data["ins_data"].empty() && !source_data["ins_data"][0]["isGap"].get<bool>();
+  source_data["anchorMask"] = isAnchored ? source_data["ins_data"][0]["mask"] : json("0x0");
+  source_data["anchorValue"] = isAnchored ? source_data["ins_data"][0]["value"] : json("0x0");
+  if (backend == Backend::Table) source_data["table"] = injaEnv.render(tableTemplate, generateTableData(source_data["ins_data"], idiom_name));
+  include_data["source"] = injaEnv.render(sourceTemplate, source_data);
   std::string inc_string = injaEnv.render(includeTemplate, include_data);
-  std::string src_string = injaEnv.render(sourceTemplate, source_data);
 
-  return {inc_string, src_string};
+  json idiom_info;
+  idiom_info["idiom_name"] = idiom_name;
+  idiom_info["isAnchored"] = false;
+  idiom_info["capturesLabels"] = numLabs != 0;
+  // all 0 without a first line to anchor on, which lets every instruction through
+  idiom_info["anchorMask"] = source_data["anchorMask"];
+  idiom_info["anchorValue"] = source_data["anchorValue"];
+  if (isAnchored) {
+    const struct powerpc_opcode* anchor = powerpc_opcodes + source_data["ins_data"][0]["opindex"].get<int>();
+    // every PowerPC opcode mask covers the primary opcode, but do not rely on it for dispatching
+    if ((anchor->mask & 0xfc000000) == 0xfc000000) {
+      idiom_info["isAnchored"] = true;
+      idiom_info["primaryOpcode"] = (anchor->opcode >> 26) & 0x3f;
+    }
+  }
+
+  return {inc_string, idiom_info};
+}
+
+// same as aipg::REGISTER_FIELD_*
+constexpr uint32_t FIELD_PRESENT = 0x80;
+constexpr uint32_t FIELD_ZERO_IS_NONE = 0x40;
+constexpr uint32_t FIELD_THROUGH_R31 = 0x20;
+constexpr uint32_t FIELD_ALL = FIELD_ZERO_IS_NONE | FIELD_THROUGH_R31;
+
+// How an opcode accesses its first operand when that is a register, the other register operands are read
+enum class FirstOperandAccess {
+  Write,
+  Read,
+  ReadWrite,
+};
+
+// Classifies the opcodes whose encoding matches value under mask and, if flags is not 0, that belong to one of its dialects
+struct FirstOperandRule {
+  uint32_t mask;
+  uint32_t value;
+  ppc_cpu_t flags;
+  FirstOperandAccess access;
+  // FIELD_* flags of the first register field, for the opcodes that access a range of registers starting there
+  uint32_t rangeFlags;
+};
+
+constexpr FirstOperandRule primaryOpcodeRule(uint32_t primaryOpcode, FirstOperandAccess access, uint32_t rangeFlags = 0) {
+  return {0xfc000000, primaryOpcode << 26, 0, access, rangeFlags};
+}
+
+// X form, the extended opcode is in bits 1-10
+constexpr FirstOperandRule extendedOpcodeRule(uint32_t primaryOpcode, uint32_t extendedOpcode, FirstOperandAccess access, uint32_t rangeFlags = 0) {
+  return {0xfc0007fe, primaryOpcode << 26 | extendedOpcode << 1, 0, access, rangeFlags};
+}
+
+// Extended opcodes of primary opcode 31 whose first register operand is read: traps, stores, moves to special registers,
+// cache and TLB management. Operands written as RA|0 are addresses, which are read without being listed here
+const uint32_t X_FORM_FIRST_OPERAND_READ_OPCODES[] = {
+  4, 68,                                                                               // tw, td
+  149, 151, 181, 183, 215, 247, 407, 439, 660, 662, 918,                               // stdx, stwx, stdux, stwux, stbx, stbux, sthx, sthux, stdbrx, stwbrx, sthbrx
+  150, 182, 214, 694, 726, 710, 742,                                                   // stwcx., stqcx., stdcx., stbcx., sthcx., stwat, stdat
+  663, 695, 727, 759, 919, 983,                                                        // stfsx, stfsux, stfdx, stfdux, stfdpx, stfiwx
+  157, 159, 223, 415, 735, 643, 675, 707, 739, 803, 917, 949, 981, 1013,               // st*epx, st*dx, st*cix
+  131, 144, 146, 178, 210, 242, 82, 114, 387, 419, 451, 462, 467,                      // wrtee, mtcrf, mtmsr, mtmsrd, mtsr, mtsrin, mtsrd, mtsrdin, mtdcr*, mtpmr, mtspr
+  438, 342, 374, 774, 902, 910, 942,                                                   // ecowx, dst, dstst, copy, paste., tabort., treclaim.
+  54, 86, 246, 278, 470, 758, 982, 1014, 63, 127, 991, 1023,                           // dcbst, dcbf, dcbtst, dcbt, dcbi, dcba, icbi, dcbz, *ep
+  274, 306, 402, 434, 466, 786, 978, 1010, 142, 174, 206, 238,                         // tlbiel, tlbie, slbmte, slbie, slbieg, tlbivax, tlbwe, tlbli, msg*
+};
+
+// Rules classifying the first register operand of every opcode, the first one matching applies: the exceptions of a primary
+// opcode come before the rule for all of its opcodes. Primary opcodes without such a rule have no register first operand
+std::vector<FirstOperandRule> firstOperandRules() {
+  std::vector<FirstOperandRule> rules = {
+    // string loads and stores access as many registers as NB or XER holds bytes, wrapping around to r0
+    extendedOpcodeRule(31, 533, FirstOperandAccess::Write, FIELD_ALL), // lswx
+    extendedOpcodeRule(31, 597, FirstOperandAccess::Write, FIELD_ALL), // lswi
+    extendedOpcodeRule(31, 661, FirstOperandAccess::Read, FIELD_ALL), // stswx
+    extendedOpcodeRule(31, 725, FirstOperandAccess::Read, FIELD_ALL), // stswi
+    // paired single indexed stores (psq_stx, psq_stux), with a 6 bit extended opcode
+    {0xfc00007e, 4u << 26 | 7u << 1, PPC_OPCODE_PPCPS, FirstOperandAccess::Read, 0},
+    {0xfc00007e, 4u << 26 | 39u << 1, PPC_OPCODE_PPCPS, FirstOperandAccess::Read, 0},
+  };
+  // SPE stores, with an 11 bit extended opcode
+  for (uint32_t extendedOpcode : {800, 801, 802, 803, 804, 805, 816, 817, 820, 821, 824, 825, 828, 829})
+    rules.push_back({0xfc0007ff, 4u << 26 | extendedOpcode, PPC_OPCODE_SPE, FirstOperandAccess::Read, 0});
+  for (uint32_t extendedOpcode : X_FORM_FIRST_OPERAND_READ_OPCODES)
+    rules.push_back(extendedOpcodeRule(31, extendedOpcode, FirstOperandAccess::Read));
+  // rotate and insert instructions keep the bits of RA outside the mask: rlwimi, rlmi and rldimi (MD form, extended opcode in bits 2-4)
+  rules.push_back(primaryOpcodeRule(20, FirstOperandAccess::ReadWrite));
+  rules.push_back(primaryOpcodeRule(22, FirstOperandAccess::ReadWrite));
+  rules.push_back({0xfc00001c, 30u << 26 | 3u << 2, 0, FirstOperandAccess::ReadWrite, 0});
+  // the first register of a load or store multiple is followed by all the registers up to r31
+  rules.push_back(primaryOpcodeRule(46, FirstOperandAccess::Write, FIELD_THROUGH_R31));
+  rules.push_back(primaryOpcodeRule(47, FirstOperandAccess::Read, FIELD_THROUGH_R31));
+  // trap immediates, compares and D form stores, paired single stores included
+  for (uint32_t primaryOpcode : {2, 3, 10, 11, 36, 37, 38, 39, 44, 45, 52, 53, 54, 55, 60, 61, 62})
+    rules.push_back(primaryOpcodeRule(primaryOpcode, FirstOperandAccess::Read));
+  for (uint32_t primaryOpcode : {4, 7, 8, 9, 12, 13, 14, 15, 19, 21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 40, 41, 42, 43, 48, 49, 50, 51, 56, 57, 58, 59, 63})
+    rules.push_back(primaryOpcodeRule(primaryOpcode, FirstOperandAccess::Write));
+  return rules;
+}
+
+// The rule classifying the first register operand of opcode, or nullptr if none does
+const FirstOperandRule* findFirstOperandRule(const std::vector<FirstOperandRule>& rules, const powerpc_opcode* opcode) {
+  for (const FirstOperandRule& rule : rules) {
+    if ((opcode->mask & rule.mask) == rule.mask && (opcode->opcode & rule.mask) == rule.value && (rule.flags == 0 || (opcode->flags & rule.flags) != 0))
+      return &rule;
+  }
+  return nullptr;
+}
+
+// Appends a register field to fields, packed as described by aipg::OpcodeRegisterFields
+void packRegisterField(uint32_t& fields, uint32_t field, const powerpc_opcode* opcode) {
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+    if (((fields >> shift) & 0xff) == 0) {
+      fields |= field << shift;
+      return;
+    }
+  }
+  std::cerr << "Opcode " << opcode->name << " has more than 4 register operands of a kind" << std::endl;
+  exit(-1);
+}
+
+// Generates the table of the registers read and written by every opcode of powerpc_opcodes, bucketed by primary opcode,
+// which ... constraints use to find the registers an instruction accesses without disassembling it
+std::string generateRegisterUseTable() {
+  std::vector<FirstOperandRule> rules = firstOperandRules();
+  std::vector<std::string> unclassified;
+  std::vector<json> buckets[64];
+  for (unsigned int opcodeIdx = 0; opcodeIdx < powerpc_num_opcodes; opcodeIdx++) {
+    const powerpc_opcode* opcode = powerpc_opcodes + opcodeIdx;
+    std::string mnemonic = opcode->name;
+    uint32_t gprReads = 0, gprWrites = 0, fprReads = 0, fprWrites = 0;
+    bool isFirstRegister = true;
+    for (const ppc_opindex_t* opindex = opcode->operands; *opindex != 0; opindex++) {
+      const powerpc_operand* operand = powerpc_operands + *opindex;
+      bool isGpr = (operand->flags & (PPC_OPERAND_GPR | PPC_OPERAND_GPR_0)) != 0;
+      bool isFpr = (operand->flags & PPC_OPERAND_FPR) != 0;
+      if ((!isGpr && !isFpr) || (operand->flags & PPC_OPERAND_FAKE) != 0 || operand->shift < 0) continue;
+
+      uint32_t field = FIELD_PRESENT | operand->shift;
+      if ((operand->flags & PPC_OPERAND_GPR_0) != 0) field |= FIELD_ZERO_IS_NONE;
+
+      // the base register of update forms is read and written back, a register written as RA|0 is an address and only read
+      bool isRead = true, isWrite = *opindex == RAS || *opindex == RAL;
+      if (isFirstRegister && opindex == opcode->operands && (operand->flags & PPC_OPERAND_GPR_0) == 0) {
+        const FirstOperandRule* rule = findFirstOperandRule(rules, opcode);
+        if (rule == nullptr) {
+          unclassified.push_back(mnemonic);
+        } else {
+          isRead = rule->access != FirstOperandAccess::Write;
+          isWrite = rule->access != FirstOperandAccess::Read;
+          field |= rule->rangeFlags;
+        }
+      }
+      isFirstRegister = false;
+      if (isRead) packRegisterField(isGpr ? gprReads : fprReads, field, opcode);
+      if (isWrite) packRegisterField(isGpr ? gprWrites : fprWrites, field, opcode);
+    }
+
+    json entry;
+    entry["name"] = mnemonic;
+    entry["mask"] = hexString(opcode->mask & 0xffffffff);
+    entry["value"] = hexString(opcode->opcode & 0xffffffff);
+    entry["flags"] = hexString(opcode->flags);
+    entry["deprecated"] = hexString(opcode->deprecated);
+    entry["gprReads"] = hexString(gprReads);
+    entry["gprWrites"] = hexString(gprWrites);
+    entry["fprReads"] = hexString(fprReads);
+    entry["fprWrites"] = hexString(fprWrites);
+    // opcodes whose mask does not cover the whole primary opcode go in every bucket they may match
+    for (uint32_t primaryOpcode = 0; primaryOpcode < 64; primaryOpcode++) {
+      if (((primaryOpcode << 26) & opcode->mask) == (opcode->opcode & opcode->mask & 0xfc000000))
+        buckets[primaryOpcode].push_back(entry);
+    }
+  }
+
+  if (!unclassified.empty()) {
+    std::cerr << "No rule tells whether the first register operand of these opcodes is read or written, add them to firstOperandRules:";
+    for (const std::string& mnemonic : unclassified)
+      std::cerr << " " << mnemonic;
+    std::cerr << std::endl;
+    exit(-1);
+  }
+
+  json table_data;
+  table_data["opcodes"] = json::array();
+  table_data["bucketStarts"] = json::array();
+  for (const std::vector<json>& bucket : buckets) {
+    table_data["bucketStarts"].push_back(table_data["opcodes"].size());
+    for (const json& entry : bucket)
+      table_data["opcodes"].push_back(entry);
+  }
+  table_data["bucketStarts"].push_back(table_data["opcodes"].size());
+  if (table_data["opcodes"].size() > UINT16_MAX) {
+    std::cerr << "Too many opcodes for the register use table" << std::endl;
+    exit(-1);
+  }
+
+  return injaEnv.render(registerUseTableTemplate, table_data);
+}
+
+// Generates a scanner that tests every idiom in idiom_infos at each start position, dispatching on the primary opcode of each instruction.
+// Each case of the dispatch tests its idioms in the order of idiom_infos, so that matches at the same position are reported in that order
+std::string generateCombinedScanner(const std::vector<json>& idiom_infos, const std::string& combined_name) {
+  json combined_data;
+  combined_data["combined_name"] = combined_name;
+  combined_data["idioms"] = idiom_infos;
+  combined_data["capturesLabels"] = std::any_of(idiom_infos.begin(), idiom_infos.end(), [](const json& idiom) { return idiom["capturesLabels"].get<bool>(); });
+
+  // one case per primary opcode some idiom is anchored on, the idioms without an anchor are tested in all of them and in the default case
+  std::map<uint32_t, json> groups;
+  for (const json& idiom : idiom_infos) {
+    if (idiom["isAnchored"]) groups[idiom["primaryOpcode"]]["idioms"] = json::array();
+  }
+  json unanchored = json::array();
+  for (const json& idiom : idiom_infos) {
+    if (idiom["isAnchored"]) {
+      groups[idiom["primaryOpcode"]]["idioms"].push_back(idiom);
+      continue;
+    }
+    unanchored.push_back(idiom);
+    for (auto& [primaryOpcode, group] : groups) group["idioms"].push_back(idiom);
+  }
+  combined_data["groups"] = json::array();
+  for (auto& [primaryOpcode, group] : groups) {
+    group["isDefault"] = false;
+    group["primaryOpcode"] = primaryOpcode;
+    combined_data["groups"].push_back(group);
+  }
+  combined_data["groups"].push_back({{"isDefault", true}, {"idioms", unanchored}});
+
+  return injaEnv.render(combinedTemplate, combined_data);
 }
 }
 
@@ -495,10 +1142,13 @@ using namespace aipg;
 
 int main(int argc, char** argv) {
   char* out = (char*) "./";
+  char* combined_name = nullptr;
+  std::optional<ppc_cpu_t> dialect;
+  Backend backend = Backend::Code;
   std::vector<std::string> idiom_paths;
 
   // parse args
-  std::string usage_string = "Usage: aipg [--out out] file1.idiom file2.idiom ...";
+  std::string usage_string = "Usage: aipg [--out out] [--combine name] [--dialect ppc,750,...] [--backend code|table] file1.idiom file2.idiom ...";
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--out") == 0) {
       i++;
@@ -508,6 +1158,32 @@ int main(int argc, char** argv) {
         std::cerr << "Expected path after --out" << std::endl;
         exit(-1);
       }
+    } else if (strcmp(argv[i], "--combine") == 0) {
+      i++;
+      if (i < argc) {
+        combined_name = argv[i];
+      } else {
+        std::cerr << "Expected scanner name after --combine" << std::endl;
+        exit(-1);
+      }
+    } else if (strcmp(argv[i], "--dialect") == 0) {
+      i++;
+      if (i < argc) {
+        dialect = parseDialect(argv[i]);
+      } else {
+        std::cerr << "Expected dialect after --dialect" << std::endl;
+        exit(-1);
+      }
+    } else if (strcmp(argv[i], "--backend") == 0) {
+      i++;
+      if (i < argc && strcmp(argv[i], "code") == 0) {
+        backend = Backend::Code;
+      } else if (i < argc && strcmp(argv[i], "table") == 0) {
+        backend = Backend::Table;
+      } else {
+        std::cerr << "Expected code or table after --backend" << std::endl;
+        exit(-1);
+      }
     } else if (strcmp(argv[i], "--help") == 0) {
       std::cout << usage_string << std::endl;
       exit(0);
@@ -525,7 +1201,7 @@ int main(int argc, char** argv) {
     std::filesystem::copy(CTX_INC_FILE, out);
 
   std::filesystem::path inc_path(out);
-  std::filesystem::path src_path(out);
+  std::vector<json> idiom_infos;
   for (const auto& idiom_path : idiom_paths) {
     std::ifstream idiom_file(idiom_path);
     if (idiom_file.is_open()) {
@@ -534,20 +1210,13 @@ int main(int argc, char** argv) {
     
       std::filesystem::path idiom_filepath(idiom_path);
       std::filesystem::path idiom_stem = idiom_filepath.stem();
-      std::string idiom_src_filename = idiom_stem.string() + ".cpp";
       std::string idiom_inc_filename = idiom_stem.string() + ".hpp";
-      std::ofstream idiom_parser_src(src_path / idiom_src_filename);
       std::ofstream idiom_parser_inc(inc_path / idiom_inc_filename);
 
       std::string idiom_name = idiom_stem.string();
-      auto [inc_string, src_string] = generateParser(buffer.str(), idiom_name);
+      auto [inc_string, idiom_info] = generateParser(buffer.str(), idiom_name, dialect, backend);
+      idiom_infos.push_back(idiom_info);
 
-      if (idiom_parser_src.is_open()) {
-        idiom_parser_src << src_string;
-      } else {
-        std::cerr << "Failed to open output src file " << idiom_src_filename << std::endl;
-        exit(-1);
-      }
       if (idiom_parser_inc.is_open()) {
         idiom_parser_inc << inc_string;
       } else {
@@ -559,4 +1228,24 @@ int main(int argc, char** argv) {
       exit(-1);
     }
   }
+
+  std::string register_use_inc_filename = "RegisterUseTable.hpp";
+  std::ofstream register_use_inc(inc_path / register_use_inc_filename);
+  if (register_use_inc.is_open()) {
+    register_use_inc << generateRegisterUseTable();
+  } else {
+    std::cerr << "Failed to open output include file " << register_use_inc_filename << std::endl;
+    exit(-1);
+  }
+
+  if (combined_name != nullptr) {
+    std::string combined_inc_filename = std::string(combined_name) + ".hpp";
+    std::ofstream combined_inc(inc_path / combined_inc_filename);
+    if (combined_inc.is_open()) {
+      combined_inc << generateCombinedScanner(idiom_infos, combined_name);
+    } else {
+      std::cerr << "Failed to open output include file " << combined_inc_filename << std::endl;
+      exit(-1);
+    }
+  }
 }
\ No newline at end of file
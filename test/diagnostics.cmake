@@ -0,0 +1,14 @@
+# Runs aipg on each idiom of DIAGNOSTICS_DIR, all of which are malformed: each must be rejected with exactly the messages of the .err file of the same name
+file(GLOB DIAGNOSTIC_IDIOMS ${DIAGNOSTICS_DIR}/*.idiom)
+file(MAKE_DIRECTORY ${OUT_DIR})
+
+foreach (IDIOM_FILE ${DIAGNOSTIC_IDIOMS})
+  get_filename_component(IDIOM_FILE_STEM ${IDIOM_FILE} NAME_WLE)
+  execute_process(COMMAND ${AIPG} --out ${OUT_DIR} --dialect ppc ${IDIOM_FILE} RESULT_VARIABLE RESULT OUTPUT_QUIET ERROR_VARIABLE ERRORS)
+  file(READ ${DIAGNOSTICS_DIR}/${IDIOM_FILE_STEM}.err EXPECTED_ERRORS)
+  if (RESULT EQUAL 0)
+    message(SEND_ERROR "${IDIOM_FILE_STEM}: accepted, expected\n${EXPECTED_ERRORS}")
+  elseif (NOT ERRORS STREQUAL EXPECTED_ERRORS)
+    message(SEND_ERROR "${IDIOM_FILE_STEM}: got\n${ERRORS}expected\n${EXPECTED_ERRORS}")
+  endif ()
+endforeach ()
\ No newline at end of file
@@ -0,0 +1,12 @@
+// Includes the generated parsers in a second translation unit of parse_test, which must link with the first one
+
+#include <cstdint>
+#include <iterator>
+
+#include "Udiv.hpp"
+#include "AllIdioms.hpp"
+
+bool matchUdivInOtherTu(const uint32_t* first, const uint32_t* last) {
+  aipg::UdivContext parseCtx;
+  return aipg::matchUdiv(first, last, PPC_OPCODE_PPC, parseCtx);
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 
 #include <iostream>
+#include <map>
+#include <span>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -7,8 +10,20 @@
 #include "ppcdisasm/ppc-relocations.h"
 
 #include "aipg/aipg.hpp"
+#include "aipg/matches.hpp"
+#include "aipg/prefilter.hpp"
+#include "aipg/relocations.hpp"
+#include "aipg/symbolcache.hpp"
 #include "Udiv.hpp"
 #include "LabelTest.hpp"
+#include "BoundedGap.hpp"
+#include "FunctionGap.hpp"
+#include "DefinedOperands.hpp"
+#include "LeadingGap.hpp"
+#include "ReadConstraint.hpp"
+#include "ManyCaptures.hpp"
+#include "ManyCapturesUnbounded.hpp"
+#include "AllIdioms.hpp"
 
 /*
 original ASM:
@@ -23,6 +38,16 @@ srawi   r0, r0, 5
 srwi    r5, r0, 0x1f
 add     r6, r0, r5
 */
+constexpr uint32_t UDIV_INS[] = {0x3c608889, 0x811c0014, 0x38038889, 0x38800000, 0x7c003896, 0x38600001, 0x7c003a14, 0x7c002e70, 0x54050ffe, 0x7cc02a14};
+
+// the parts one after the other
+static std::vector<uint32_t> concat(std::initializer_list<std::span<const uint32_t>> parts) {
+  std::vector<uint32_t> ins;
+  for (std::span<const uint32_t> part : parts)
+    ins.insert(ins.end(), part.begin(), part.end());
+  return ins;
+}
+
 TEST(IdiomTest, Udiv) {
   uint32_t ins[] = {0x3c608889, 0x811c0014, 0x38038889, 0x38800000, 0x7c003896, 0x38600001, 0x7c003a14, 0x7c002e70, 0x54050ffe, 0x7cc02a14};
   aipg::Context parseCtx;
@@ -48,6 +73,49 @@ TEST(IdiomTest, Udiv) {
   EXPECT_EQ(parseCtx.imms[3], 5);
 }
 
+bool matchUdivInOtherTu(const uint32_t* first, const uint32_t* last);
+
+// the generated parsers are included in both translation units of this test
+TEST(IdiomOtherTuTest, Udiv) {
+  const auto& ins = UDIV_INS;
+  aipg::UdivContext parseCtx;
+  EXPECT_TRUE(aipg::matchUdiv(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_TRUE(matchUdivInOtherTu(std::begin(ins), std::end(ins)));
+}
+
+// same test as above, with the dialect fixed at compile time
+TEST(IdiomFixedDialectTest, Udiv) {
+  const auto& ins = UDIV_INS;
+  aipg::UdivContext parseCtx;
+  ASSERT_TRUE(aipg::matchUdiv<PPC_OPCODE_PPC>(std::begin(ins), std::end(ins), parseCtx));
+  EXPECT_EQ(parseCtx.matchInsIdxs[3], 7);
+  EXPECT_EQ(parseCtx.imms[3], 5);
+  // mulhw is not available in POWER
+  EXPECT_FALSE(aipg::matchUdiv<PPC_OPCODE_POWER>(std::begin(ins), std::end(ins), parseCtx));
+
+  // the dialect given to aipg --dialect
+  static_assert(aipg::UdivDialect == PPC_OPCODE_PPC);
+  EXPECT_TRUE(aipg::matchUdiv(std::begin(ins), std::end(ins), parseCtx));
+  uint32_t numMatches = 0;
+  aipg::scanUdiv(std::begin(ins), std::end(ins), 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t, const aipg::UdivContext&) { numMatches++; });
+  EXPECT_EQ(numMatches, 1);
+}
+
+// same test as above, reading the captures from named fields
+TEST(IdiomCapturesTest, Udiv) {
+  const auto& ins = UDIV_INS;
+  aipg::UdivCaptures captures;
+  ASSERT_TRUE(aipg::matchUdiv(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, captures));
+
+  EXPECT_EQ(captures.matchInsIdxs[3], 7);
+  EXPECT_EQ(captures.gpr1, 7);
+  EXPECT_EQ(captures.gpr3, 0);
+  EXPECT_EQ(captures.gpr9, 3);
+  EXPECT_EQ(captures.imm1, -30583);
+  EXPECT_EQ(captures.imm3, 5);
+}
+
 // same test as above with a li   r3, 0x18 as the second instruction to fail the register overwrite instruction constraint
 TEST(IdiomTestWriteConstraintNegative, Udiv) {
   uint32_t ins[] = {0x3c608889, 0x38600018, 0x811c0014, 0x38038889, 0x38800000, 0x7c003896, 0x38600001, 0x7c003a14, 0x7c002e70, 0x54050ffe, 0x7cc02a14};
@@ -57,6 +125,336 @@ TEST(IdiomTestWriteConstraintNegative, Udiv) {
   EXPECT_FALSE(match);
 }
 
+// li r3, 1; <in between>; lis r3, 0x10
+TEST(IdiomTestReadConstraint, ReadConstraint) {
+  // rlwinm r3, r5, 0, 0, 31 only writes r3
+  uint32_t rlwinmIns[] = {0x38600001, 0x54a3003e, 0x3c600010};
+  // rlwimi r3, r5, 0, 0, 31 keeps the bits of r3 outside the mask, so it reads r3 too
+  uint32_t rlwimiIns[] = {0x38600001, 0x50a3003e, 0x3c600010};
+  // rlwimi r4, r3, 0, 0, 31 reads r3 as its source
+  uint32_t rlwimiSourceIns[] = {0x38600001, 0x5064003e, 0x3c600010};
+  // stw r3, 8(r1)
+  uint32_t stwIns[] = {0x38600001, 0x90610008, 0x3c600010};
+  // mtlr r3
+  uint32_t mtlrIns[] = {0x38600001, 0x7c6803a6, 0x3c600010};
+  // stswi r3, r1, 8 stores r3 and r4
+  uint32_t stswiIns[] = {0x38600001, 0x7c6145aa, 0x3c600010};
+  aipg::ReadConstraintContext parseCtx;
+
+  EXPECT_TRUE(aipg::matchReadConstraint(std::begin(rlwinmIns), std::end(rlwinmIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchReadConstraint(std::begin(rlwimiIns), std::end(rlwimiIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchReadConstraint(std::begin(rlwimiSourceIns), std::end(rlwimiSourceIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchReadConstraint(std::begin(stwIns), std::end(stwIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchReadConstraint(std::begin(mtlrIns), std::end(mtlrIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchReadConstraint(std::begin(stswiIns), std::end(stswiIns), PPC_OPCODE_PPC, parseCtx));
+}
+
+// the first addi reading r3 is not the one used by mulhw, matching it must not hide the match through the second one
+TEST(IdiomTestAlternativeGap, Udiv) {
+  uint32_t ins[] = {0x3c608889, 0x38838889, 0x38038889, 0x7c003896, 0x7c002e70};
+  aipg::Context parseCtx;
+  bool match = aipg::matchUdiv(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx);
+
+  ASSERT_TRUE(match);
+
+  ASSERT_EQ(parseCtx.matchInsIdxs.size(), 4);
+  EXPECT_EQ(parseCtx.matchInsIdxs[0], 0);
+  EXPECT_EQ(parseCtx.matchInsIdxs[1], 2);
+  EXPECT_EQ(parseCtx.matchInsIdxs[2], 3);
+  EXPECT_EQ(parseCtx.matchInsIdxs[3], 4);
+
+  EXPECT_EQ(parseCtx.gprs[8], 0);
+  EXPECT_EQ(parseCtx.gprs[9], 3);
+}
+
+// lis r3, 0x8889; nop x gapLen; addi r0, r3, -0x7777
+TEST(BoundedGapTest, BoundedGap) {
+  for (uint32_t gapLen = 0; gapLen < 4; gapLen++) {
+    std::vector<uint32_t> ins = {0x3c608889};
+    ins.insert(ins.end(), gapLen, 0x60000000);
+    ins.push_back(0x38038889);
+    aipg::Context parseCtx;
+    bool match = aipg::matchBoundedGap(ins.begin(), ins.end(), PPC_OPCODE_PPC, parseCtx);
+
+    EXPECT_EQ(match, gapLen >= 1 && gapLen <= 2) << "gap of " << gapLen << " instructions";
+    if (match) {
+      ASSERT_EQ(parseCtx.matchInsIdxs.size(), 2);
+      EXPECT_EQ(parseCtx.matchInsIdxs[1], gapLen + 1);
+    }
+  }
+}
+
+// li r3, 1; li r4, 2 to li r4, numLis + 1; addi r5, r4, numLis + 1: only the last li completes the match
+static std::vector<uint32_t> manyCapturesIns(uint32_t numLis) {
+  std::vector<uint32_t> ins = {0x38600001};
+  for (uint32_t imm = 2; imm <= numLis + 1; imm++) ins.push_back(0x38800000 | imm);
+  ins.push_back(0x38a40000 | (numLis + 1));
+  return ins;
+}
+
+TEST(ManyCapturesTest, BoundedGaps) {
+  std::vector<uint32_t> ins = manyCapturesIns(18);
+  aipg::ManyCapturesContext parseCtx;
+  ASSERT_TRUE(aipg::matchManyCaptures(ins.begin(), ins.end(), PPC_OPCODE_PPC, parseCtx, 0, ppcdisasm::defaultSymbolGetter));
+  EXPECT_EQ(parseCtx.matchInsIdxs[1], ins.size() - 2);
+}
+
+TEST(ManyCapturesTest, UnboundedGaps) {
+  // every partial match is kept, however many distinct captures wait on the same line
+  for (uint32_t numLis : {16, 17, 200}) {
+    std::vector<uint32_t> ins = manyCapturesIns(numLis);
+    aipg::ManyCapturesUnboundedContext parseCtx;
+    ASSERT_TRUE(aipg::matchManyCapturesUnbounded(ins.begin(), ins.end(), PPC_OPCODE_PPC, parseCtx, 0, ppcdisasm::defaultSymbolGetter)) << numLis << " li";
+    EXPECT_EQ(parseCtx.matchInsIdxs[1], ins.size() - 2) << numLis << " li";
+  }
+}
+
+// addi r3, r3, 1; li r4, 5: the match starts at the addi, consumed by the leading gap
+TEST(LeadingGapTest, LeadingGap) {
+  uint32_t ins[] = {0x38630001, 0x38800005};
+  aipg::LeadingGapContext parseCtx;
+  ASSERT_TRUE(aipg::matchLeadingGap(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_EQ(parseCtx.matchInsIdxs[0], 1);
+  EXPECT_FALSE(aipg::matchLeadingGap(std::begin(ins) + 1, std::end(ins), PPC_OPCODE_PPC, parseCtx));
+
+  // the scanners must not skip start positions that do not match the first mnemonic
+  std::vector<uint32_t> startIdxs;
+  aipg::scanLeadingGap(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::LeadingGapContext&) { startIdxs.push_back(startIdx); });
+  EXPECT_EQ(startIdxs, (std::vector<uint32_t>{0}));
+
+  std::vector<uint32_t> streamStartIdxs;
+  aipg::StreamScannerLeadingGap scanner(PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::LeadingGapContext&) { streamStartIdxs.push_back(startIdx); });
+  scanner.feed(ins, std::size(ins));
+  scanner.finish();
+  EXPECT_EQ(streamStartIdxs, (std::vector<uint32_t>{0}));
+
+  std::vector<uint32_t> combinedStartIdxs;
+  aipg::scanAllIdioms(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](aipg::AllIdiomsIdiom idiom, uint32_t startIdx, const aipg::Context&) {
+      if (idiom == aipg::AllIdiomsIdiom::LeadingGap) combinedStartIdxs.push_back(startIdx);
+    });
+  EXPECT_EQ(combinedStartIdxs, (std::vector<uint32_t>{0}));
+}
+
+// lis r3, 0x8889; <in between>; addi r0, r3, -0x7777
+TEST(FunctionGapTest, FunctionGap) {
+  uint32_t start_vma = 0x80004000;
+  uint32_t nopIns[] = {0x3c608889, 0x60000000, 0x38038889};
+  uint32_t blrIns[] = {0x3c608889, 0x4e800020, 0x38038889};
+  uint32_t bIns[] = {0x3c608889, 0x48000010, 0x38038889};
+  uint32_t blIns[] = {0x3c608889, 0x48000011, 0x38038889};
+  SymbolGetter symGetter = [](uint32_t address) -> RelocationTarget {
+    if (address == 0x80004004) {
+      return {R_PPC_NONE, "next_function"};
+    } else {
+      return RELOC_TARGET_NONE;
+    }
+  };
+  aipg::Context parseCtx;
+
+  EXPECT_TRUE(aipg::matchFunctionGap(std::begin(nopIns), std::end(nopIns), PPC_OPCODE_PPC, parseCtx, start_vma));
+  EXPECT_FALSE(aipg::matchFunctionGap(std::begin(blrIns), std::end(blrIns), PPC_OPCODE_PPC, parseCtx, start_vma));
+  EXPECT_FALSE(aipg::matchFunctionGap(std::begin(bIns), std::end(bIns), PPC_OPCODE_PPC, parseCtx, start_vma));
+  EXPECT_TRUE(aipg::matchFunctionGap(std::begin(blIns), std::end(blIns), PPC_OPCODE_PPC, parseCtx, start_vma));
+  EXPECT_FALSE(aipg::matchFunctionGap(std::begin(nopIns), std::end(nopIns), PPC_OPCODE_PPC, parseCtx, start_vma, symGetter));
+  // a plain ... goes on into the next function
+  EXPECT_TRUE(aipg::matchBoundedGap(std::begin(blrIns), std::end(blrIns), PPC_OPCODE_PPC, parseCtx, start_vma));
+}
+
+// li r3, 1; srawi r0, r0, 5; lis r4, 0x8889, then with the defined immediates and register changed
+TEST(DefinedOperandsTest, DefinedOperands) {
+  uint32_t ins[] = {0x38600001, 0x7c002e70, 0x3c808889};
+  uint32_t otherImmIns[] = {0x38600002, 0x7c002e70, 0x3c808889};
+  uint32_t otherGprIns[] = {0x38800001, 0x7c002e70, 0x3c808889};
+  uint32_t otherShiftIns[] = {0x38600001, 0x7c002670, 0x3c808889};
+  uint32_t otherHighIns[] = {0x38600001, 0x7c002e70, 0x3c808888};
+  aipg::Context parseCtx;
+
+  ASSERT_TRUE(aipg::matchDefinedOperands(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_EQ(parseCtx.gprs.at(1), 0);
+  EXPECT_FALSE(aipg::matchDefinedOperands(std::begin(otherImmIns), std::end(otherImmIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchDefinedOperands(std::begin(otherGprIns), std::end(otherGprIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchDefinedOperands(std::begin(otherShiftIns), std::end(otherShiftIns), PPC_OPCODE_PPC, parseCtx));
+  EXPECT_FALSE(aipg::matchDefinedOperands(std::begin(otherHighIns), std::end(otherHighIns), PPC_OPCODE_PPC, parseCtx));
+}
+
+// udiv sequence with an access to $GPR9 (r3) inserted after the lis, which the first ... does not allow to write
+TEST(IdiomTestRegisterUse, Udiv) {
+  auto matchWithInserted = [&](uint32_t inserted) {
+    std::vector<uint32_t> ins(std::begin(UDIV_INS), std::end(UDIV_INS));
+    ins.insert(ins.begin() + 1, inserted);
+    aipg::Context parseCtx;
+    return aipg::matchUdiv(ins.begin(), ins.end(), PPC_OPCODE_PPC, parseCtx);
+  };
+
+  EXPECT_TRUE(matchWithInserted(0x90610000)); // stw r3, 0(r1) only reads r3
+  EXPECT_FALSE(matchWithInserted(0x84a30004)); // lwzu r5, 4(r3) writes back r3
+  EXPECT_FALSE(matchWithInserted(0xb8410000)); // lmw r2, 0(r1) writes r2 to r31
+  EXPECT_TRUE(matchWithInserted(0xb8810000)); // lmw r4, 0(r1) writes r4 to r31
+  EXPECT_TRUE(matchWithInserted(0x7c6803a6)); // mtlr r3 only reads r3
+  EXPECT_FALSE(matchWithInserted(0x50a3003e)); // rlwimi r3, r5, 0, 0, 31 writes r3
+  EXPECT_TRUE(matchWithInserted(0x7c6145aa)); // stswi r3, r1, 8 only reads r3 and r4
+  EXPECT_FALSE(matchWithInserted(0x7c6144aa)); // lswi r3, r1, 8 writes r3 and r4
+}
+
+// the udiv sequence twice in a row, scanned in one pass
+TEST(IdiomScanTest, Udiv) {
+  std::vector<uint32_t> ins = concat({UDIV_INS, UDIV_INS});
+  std::vector<uint32_t> startIdxs;
+  aipg::scanUdiv(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext& parseCtx) {
+      startIdxs.push_back(startIdx);
+      EXPECT_EQ(parseCtx.matchInsIdxs, (std::array<uint32_t, 4>{0, 2, 4, 7}));
+      EXPECT_EQ(parseCtx.imms.at(3), 5);
+      EXPECT_TRUE(parseCtx.immsBound & (1ull << 3));
+    });
+
+  ASSERT_EQ(startIdxs.size(), 2);
+  EXPECT_EQ(startIdxs[0], 0);
+  EXPECT_EQ(startIdxs[1], 10);
+}
+
+// the udiv sequence twice in a row, only the first match is consumed
+TEST(IdiomMatchesTest, Udiv) {
+  std::vector<uint32_t> ins = concat({UDIV_INS, UDIV_INS});
+  std::vector<uint32_t> startIdxs;
+  for (auto [startIdx, parseCtx] : aipg::matches<aipg::Udiv>(ins, PPC_OPCODE_PPC)) {
+    startIdxs.push_back(startIdx);
+    EXPECT_EQ(parseCtx.matchInsIdxs, (std::array<uint32_t, 4>{0, 2, 4, 7}));
+  }
+  ASSERT_EQ(startIdxs.size(), 2);
+  EXPECT_EQ(startIdxs[0], 0);
+  EXPECT_EQ(startIdxs[1], 10);
+
+  auto udivMatches = aipg::matches<aipg::Udiv>(ins, PPC_OPCODE_PPC);
+  auto firstMatch = udivMatches.begin();
+  ASSERT_TRUE(firstMatch != udivMatches.end());
+  EXPECT_EQ(firstMatch->startIdx, 0);
+  EXPECT_EQ(firstMatch->parseCtx.imms.at(3), 5);
+}
+
+// the udiv sequence twice in a row, fed 3 instructions at a time
+TEST(IdiomStreamScanTest, Udiv) {
+  std::vector<uint32_t> ins = concat({UDIV_INS, UDIV_INS});
+  std::vector<uint32_t> startIdxs;
+  // the ... of udiv are unbounded, so the scanner is told how long a match may be
+  aipg::StreamScannerUdiv scanner(PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext& parseCtx) {
+      startIdxs.push_back(startIdx);
+      EXPECT_EQ(parseCtx.matchInsIdxs, (std::array<uint32_t, 4>{0, 2, 4, 7}));
+    }, 16);
+  for (size_t i = 0; i < ins.size(); i += 3)
+    scanner.feed(ins.data() + i, std::min<size_t>(3, ins.size() - i));
+  scanner.finish();
+
+  ASSERT_EQ(startIdxs.size(), 2);
+  EXPECT_EQ(startIdxs[0], 0);
+  EXPECT_EQ(startIdxs[1], 10);
+}
+
+// lis r3, 1 x 10000; addi r4, r3, 2: every lis starts an attempt, only those close enough to the addi match
+TEST(IdiomStreamScanTest, MaxMatchLength) {
+  constexpr uint32_t maxMatchLength = 64;
+  std::vector<uint32_t> ins(10000, 0x3c600001);
+  ins.push_back(0x38830002);
+
+  // the matches of scanFunctionGap that span at most maxMatchLength instructions
+  std::vector<uint32_t> expected;
+  for (uint32_t startIdx = ins.size() - maxMatchLength; startIdx < ins.size() - 1; startIdx++) expected.push_back(startIdx);
+  std::vector<uint32_t> startIdxs;
+  aipg::StreamScannerFunctionGap scanner(PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::FunctionGapContext& parseCtx) {
+      startIdxs.push_back(startIdx);
+      EXPECT_EQ(parseCtx.matchInsIdxs[1], ins.size() - 1 - startIdx);
+    }, maxMatchLength);
+  for (size_t i = 0; i < ins.size(); i += 100) {
+    scanner.feed(ins.data() + i, std::min<size_t>(100, ins.size() - i));
+    // the attempts that can no longer match within maxMatchLength instructions are dropped
+    EXPECT_LE(scanner.numPendingAttempts(), maxMatchLength);
+  }
+  scanner.finish();
+
+  EXPECT_EQ(startIdxs, expected);
+}
+
+// many small chunks, so that most matches cross into the next chunk
+TEST(IdiomParallelScanTest, Udiv) {
+  std::vector<uint32_t> ins;
+  for (int i = 0; i < 50; i++) {
+    ins.insert(ins.end(), std::begin(UDIV_INS), std::end(UDIV_INS));
+    ins.push_back(0x60000000 + i);
+  }
+
+  std::vector<uint32_t> expected;
+  aipg::scanUdiv(ins.begin(), ins.end(), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext&) { expected.push_back(startIdx); });
+  std::vector<uint32_t> startIdxs;
+  aipg::scanParallelUdiv(ins.begin(), ins.end(), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext& parseCtx) {
+      startIdxs.push_back(startIdx);
+      EXPECT_EQ(parseCtx.matchInsIdxs, (std::array<uint32_t, 4>{0, 2, 4, 7}));
+    }, 4);
+
+  EXPECT_EQ(expected.size(), 50);
+  EXPECT_EQ(startIdxs, expected);
+}
+
+// the vectorized prefilter must agree with the scalar one, including in the tail that does not fill a vector
+TEST(PrefilterTest, MatchesScalar) {
+  std::vector<uint32_t> words;
+  for (uint32_t i = 0; i < 77; i++)
+    words.push_back(i % 13 == 5 ? 0x3c600000 | i : 0x38000000 | i);
+  const uint32_t* begin = words.data();
+  const uint32_t* end = begin + words.size();
+
+  auto findScalar = [&](const uint32_t* first, uint32_t mask, uint32_t value) {
+    const std::byte* bytes = reinterpret_cast<const std::byte*>(first);
+    return first + (aipg::prefilter::findScalar(bytes, reinterpret_cast<const std::byte*>(end), mask, value) - bytes) / 4;
+  };
+
+  for (const uint32_t* first = begin; first != end; first++) {
+    EXPECT_EQ(aipg::prefilter::find(first, end, 0xfc1f0000, 0x3c000000), findScalar(first, 0xfc1f0000, 0x3c000000));
+  }
+  EXPECT_EQ(aipg::prefilter::find(begin, end, 0xffffffff, 0x3c60003f), findScalar(begin, 0xffffffff, 0x3c60003f));
+  EXPECT_EQ(aipg::prefilter::find(begin, end, 0xffffffff, 0x12345678), end);
+}
+
+// the udiv sequence twice in a row, stored big-endian at an unaligned address as in a raw image
+TEST(IdiomBigEndianScanTest, Udiv) {
+  std::vector<uint32_t> ins = concat({UDIV_INS, UDIV_INS});
+  std::vector<uint8_t> image(1);
+  for (uint32_t insn : ins) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      image.push_back(insn >> shift);
+  }
+  // a trailing partial word is ignored
+  image.push_back(0x3c);
+  aipg::BigEndianWords words(image.data() + 1, image.size() - 1);
+  ASSERT_EQ(words.size(), 20);
+  EXPECT_EQ(words.begin()[2], 0x38038889);
+
+  aipg::UdivContext parseCtx;
+  ASSERT_TRUE(aipg::matchUdiv(words, PPC_OPCODE_PPC, parseCtx));
+  EXPECT_EQ(parseCtx.matchInsIdxs[3], 7);
+  EXPECT_EQ(parseCtx.imms[3], 5);
+
+  std::vector<uint32_t> startIdxs;
+  aipg::scanUdiv(words, PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext&) { startIdxs.push_back(startIdx); });
+  EXPECT_EQ(startIdxs, (std::vector<uint32_t>{0, 10}));
+
+  std::vector<uint32_t> parallelStartIdxs;
+  aipg::scanParallelUdiv(words, PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](uint32_t startIdx, const aipg::UdivContext&) { parallelStartIdxs.push_back(startIdx); }, 4);
+  EXPECT_EQ(parallelStartIdxs, startIdxs);
+
+  // the anchor is searched for in the raw bytes
+  aipg::BigEndianWordIterator found = aipg::prefilter::findBigEndian(words.begin() + 1, words.end(), 0xffffffff, 0x3c608889);
+  EXPECT_EQ(found - words.begin(), 10);
+}
+
 /*
 Test with relocations and labels
 
@@ -67,6 +465,25 @@ Test with relocations and labels
  80510400 90A30000  stw         r5, 0(r3)
  80510404 8064D6E0  lwz         r3, lbl_809bd6e0@l(r4)
 */
+constexpr uint32_t LABEL_TEST_INS[] = {0x4182005c, 0x3ca0808b, 0x3c80809c, 0x38a52c10, 0x90A30000, 0x8064d6e0};
+
+// the relocations of the label test sequence
+static RelocationTarget labelTestSymbol(uint32_t address) {
+  if (address == 0x805103f0) {
+    return {R_PPC_ADDR14, "lbl_8051044c"};
+  } else if (address == 0x805103f4) {
+    return {R_PPC_ADDR16_HA, "lbl_808b2c10"};
+  } else if (address == 0x805103f8) {
+    return {R_PPC_ADDR16_HA, "lbl_809bd6e0"};
+  } else if (address == 0x805103fc) {
+    return {R_PPC_ADDR16_LO, "lbl_808b2c10"};
+  } else if (address == 0x80510404) {
+    return {R_PPC_ADDR16_LO, "lbl_809bd6e0"};
+  } else {
+    return RELOC_TARGET_NONE;
+  }
+}
+
 TEST(LabelTestPositive, LatelTest) {
   uint32_t start_vma = 0x805103f0;
   uint32_t ins[] = {0x4182005c, 0x3ca0808b, 0x3c80809c, 0x38a52c10, 0x90A30000, 0x8064d6e0};
@@ -102,6 +519,115 @@ TEST(LabelTestPositive, LatelTest) {
   EXPECT_STREQ(parseCtx.labs[2].c_str(), "lbl_808b2c10");
 }
 
+// same test as above, with a getter returning views of names it owns, which the matcher calls without type erasure
+TEST(LabelTestSymbolView, LatelTest) {
+  uint32_t start_vma = 0x805103f0;
+  const auto& ins = LABEL_TEST_INS;
+  static const std::string names[] = {"lbl_8051044c", "lbl_808b2c10", "lbl_809bd6e0"};
+  auto symGetter = [](uint32_t address) -> aipg::SymbolView {
+    switch (address) {
+    case 0x805103f0: return {R_PPC_ADDR14, names[0]};
+    case 0x805103f4: return {R_PPC_ADDR16_HA, names[1]};
+    case 0x805103f8: return {R_PPC_ADDR16_HA, names[2]};
+    case 0x805103fc: return {R_PPC_ADDR16_LO, names[1]};
+    case 0x80510404: return {R_PPC_ADDR16_LO, names[2]};
+    default: return {R_PPC_NONE, ""};
+    }
+  };
+  aipg::LabelTestContext parseCtx;
+  ASSERT_TRUE(aipg::matchLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx, start_vma, symGetter));
+  EXPECT_EQ(parseCtx.labs[1], "lbl_8051044c");
+  EXPECT_EQ(parseCtx.labs[2], "lbl_808b2c10");
+
+  std::vector<uint32_t> startIdxs;
+  aipg::scanLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, start_vma, symGetter,
+    [&](uint32_t startIdx, const aipg::LabelTestContext&) { startIdxs.push_back(startIdx); });
+  EXPECT_EQ(startIdxs, std::vector<uint32_t>{0});
+}
+
+// same test as above, with the relocations given to the built-in index
+TEST(LabelTestRelocationIndex, LatelTest) {
+  uint32_t start_vma = 0x805103f0;
+  const auto& ins = LABEL_TEST_INS;
+  aipg::RelocationIndex relocations({
+    {0x80510404, R_PPC_ADDR16_LO, "lbl_809bd6e0"},
+    {0x805103f4, R_PPC_ADDR16_HA, "lbl_808b2c10"},
+    {0x805103f0, R_PPC_ADDR14, "lbl_8051044c"},
+    {0x805103fc, R_PPC_ADDR16_LO, "lbl_808b2c10"},
+    {0x805103f8, R_PPC_ADDR16_HA, "lbl_809bd6e0"},
+    // only the first relocation given for an address is kept
+    {0x805103f8, R_PPC_ADDR16_LO, "lbl_80000000"},
+  });
+  ASSERT_EQ(relocations.size(), 5);
+  EXPECT_EQ(relocations.numSymbols(), 3);
+  EXPECT_EQ(relocations.symbolId(0x805103f4), relocations.symbolId(0x805103fc));
+  EXPECT_EQ(relocations.symbolName(relocations.symbolId(0x80510404)), "lbl_809bd6e0");
+  EXPECT_EQ(relocations.kind(0x805103f8), R_PPC_ADDR16_HA);
+  EXPECT_EQ(relocations.symbolId(0x80510400), aipg::RelocationIndex::NO_SYMBOL);
+  EXPECT_EQ(relocations.symbolId(0x805103ec), aipg::RelocationIndex::NO_SYMBOL);
+  EXPECT_EQ(relocations.symbolId(0x80510408), aipg::RelocationIndex::NO_SYMBOL);
+
+  aipg::LabelTestContext parseCtx;
+  ASSERT_TRUE(aipg::matchLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx, start_vma, relocations));
+  EXPECT_EQ(parseCtx.labs[1], "lbl_8051044c");
+  EXPECT_EQ(parseCtx.labs[2], "lbl_808b2c10");
+}
+
+// the label test sequence scanned for all idioms at once, with the symbols of each address resolved once
+TEST(LabelTestSymbolCache, AllIdioms) {
+  uint32_t start_vma = 0x805103f0;
+  const auto& ins = LABEL_TEST_INS;
+  std::map<uint32_t, uint32_t> numCalls;
+  auto symGetter = [&](uint32_t address) -> RelocationTarget {
+    numCalls[address]++;
+    return labelTestSymbol(address);
+  };
+  auto scan = [&](const auto& getter) {
+    std::vector<std::pair<aipg::AllIdiomsIdiom, uint32_t>> matches;
+    aipg::scanAllIdioms(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, start_vma, getter,
+      [&](aipg::AllIdiomsIdiom idiom, uint32_t startIdx, const aipg::Context&) { matches.push_back({idiom, startIdx}); });
+    return matches;
+  };
+
+  auto expected = scan(symGetter);
+  ASSERT_FALSE(expected.empty());
+  uint32_t uncachedCalls = 0;
+  for (auto [address, calls] : numCalls)
+    uncachedCalls += calls;
+  ASSERT_GT(uncachedCalls, numCalls.size());
+
+  numCalls.clear();
+  aipg::SymbolCache cachedGetter(symGetter, std::size(ins));
+  EXPECT_EQ(scan(cachedGetter), expected);
+  for (auto [address, calls] : numCalls)
+    EXPECT_EQ(calls, 1) << std::hex << address;
+}
+
+// the label test sequence scanned with a getter returning owned names, which are interned for the duration of the scan
+TEST(LabelTestInterning, LatelTest) {
+  uint32_t start_vma = 0x805103f0;
+  const auto& ins = LABEL_TEST_INS;
+  auto symGetter = labelTestSymbol;
+  static_assert(!aipg::hasStableSymbolNames<decltype(symGetter)>);
+
+  std::vector<std::string> labs;
+  aipg::scanLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, start_vma, symGetter,
+    [&](uint32_t, const aipg::LabelTestContext& parseCtx) { labs.assign(parseCtx.labs.begin() + 1, parseCtx.labs.end()); });
+  EXPECT_EQ(labs, (std::vector<std::string>{"lbl_8051044c", "lbl_808b2c10"}));
+
+  // the matches of all chunks are reported once scanning is done, their names must still be there
+  std::vector<std::string> parallelLabs;
+  aipg::scanParallelLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, start_vma, symGetter,
+    [&](uint32_t, const aipg::LabelTestContext& parseCtx) { parallelLabs.assign(parseCtx.labs.begin() + 1, parseCtx.labs.end()); }, 2);
+  EXPECT_EQ(parallelLabs, labs);
+
+  // interned names of the same symbol are the same string
+  aipg::InterningSymbolGetter internedGetter(symGetter);
+  aipg::LabelTestContext parseCtx;
+  ASSERT_TRUE(aipg::matchLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx, start_vma, internedGetter));
+  EXPECT_EQ(parseCtx.labs[2].data(), internedGetter(0x805103fc).name.data());
+}
+
 TEST(LabelTestNegative, LatelTest) {
   uint32_t start_vma = 0x805103f0;
   uint32_t ins[] = {0x4182005c, 0x3ca0808b, 0x3c80809c, 0x38a52c10, 0x90A30000, 0x8064d6e0};
@@ -124,4 +650,40 @@ TEST(LabelTestNegative, LatelTest) {
   bool match = aipg::matchLabelTest(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, parseCtx, start_vma, symGetter);
 
   ASSERT_FALSE(match);
+}
+
+// the label test sequence followed by the udiv sequence, scanned for all idioms at once
+TEST(CombinedScanTest, AllIdioms) {
+  uint32_t start_vma = 0x805103f0;
+  std::vector<uint32_t> ins = concat({LABEL_TEST_INS, UDIV_INS});
+  SymbolGetter symGetter = labelTestSymbol;
+  std::vector<std::pair<aipg::AllIdiomsIdiom, uint32_t>> matches;
+  aipg::scanAllIdioms(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, start_vma, symGetter,
+    [&](aipg::AllIdiomsIdiom idiom, uint32_t startIdx, const aipg::Context&) {
+      if (idiom == aipg::AllIdiomsIdiom::LabelTest || idiom == aipg::AllIdiomsIdiom::BoundedGap || idiom == aipg::AllIdiomsIdiom::Udiv)
+        matches.push_back({idiom, startIdx});
+    });
+
+  // BoundedGap and Udiv both match at 6, in the order they were passed to aipg
+  ASSERT_EQ(matches.size(), 4);
+  EXPECT_EQ(matches[0].first, aipg::AllIdiomsIdiom::LabelTest);
+  EXPECT_EQ(matches[0].second, 0);
+  EXPECT_EQ(matches[1].first, aipg::AllIdiomsIdiom::BoundedGap);
+  EXPECT_EQ(matches[1].second, 1);
+  EXPECT_EQ(matches[2].first, aipg::AllIdiomsIdiom::BoundedGap);
+  EXPECT_EQ(matches[2].second, 6);
+  EXPECT_EQ(matches[3].first, aipg::AllIdiomsIdiom::Udiv);
+  EXPECT_EQ(matches[3].second, 6);
+}
+
+// lis r3, 0x8889; li r4, 5; addi r0, r3, -0x7777: idioms anchored on the lis and LeadingGap, whose gap consumes the lis, all match at 0
+TEST(CombinedScanTest, UnanchoredOrder) {
+  uint32_t ins[] = {0x3c608889, 0x38800005, 0x38038889};
+  std::vector<std::pair<aipg::AllIdiomsIdiom, uint32_t>> matches;
+  aipg::scanAllIdioms(std::begin(ins), std::end(ins), PPC_OPCODE_PPC, 0, ppcdisasm::defaultSymbolGetter,
+    [&](aipg::AllIdiomsIdiom idiom, uint32_t startIdx, const aipg::Context&) { matches.push_back({idiom, startIdx}); });
+
+  // in the order they were passed to aipg, whether they are dispatched on the lis or tested at every instruction
+  EXPECT_EQ(matches, (std::vector<std::pair<aipg::AllIdiomsIdiom, uint32_t>>{
+    {aipg::AllIdiomsIdiom::BoundedGap, 0}, {aipg::AllIdiomsIdiom::FunctionGap, 0}, {aipg::AllIdiomsIdiom::LeadingGap, 0}}));
 }
\ No newline at end of file